@@ -0,0 +1,117 @@
+/**
+ * @file tunnelHotPath.cpp
+ * @author Liu Yu (source@liuyu.com)
+ * @brief Benchmark of the fields touched by doTunnelSoc -> onRead/onWrite.
+ * @version 1.0
+ * @date 2020-03-02
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "../link/endpoint.h"
+#include "../link/tunnel.h"
+
+using namespace mapper::link;
+
+namespace
+{
+
+// 建立 count 个 tunnel, 返回其两端端点的句柄 (乱序, 模拟各连接的事件交替到达)
+std::vector<uint64_t> createTunnels(uint32_t count, std::vector<Tunnel_t *> &tunnels)
+{
+    std::vector<uint64_t> handles;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        auto pt = Tunnel::getTunnel();
+        auto north = Endpoint::getEndpoint(PROTOCOL_TCP, TO_NORTH, TYPE_NORMAL);
+        auto south = Endpoint::getEndpoint(PROTOCOL_TCP, TO_SOUTH, TYPE_NORMAL);
+        pt->north = north;
+        pt->south = south;
+        pt->stat = TUNSTAT_ESTABLISHED;
+        north->peer = south;
+        north->container = pt;
+        north->soc = 2 * i + 1;
+        south->peer = north;
+        south->container = pt;
+        south->soc = 2 * i + 2;
+        north->highWatermark = south->highWatermark = 256 * 1024;
+        north->lowWatermark = south->lowWatermark = 64 * 1024;
+
+        tunnels.push_back(pt);
+        handles.push_back(Endpoint::handle(north));
+        handles.push_back(Endpoint::handle(south));
+    }
+    std::shuffle(handles.begin(), handles.end(), std::mt19937(1));
+
+    return handles;
+}
+
+void releaseTunnels(std::vector<Tunnel_t *> &tunnels)
+{
+    for (auto pt : tunnels)
+    {
+        Endpoint::releaseEndpoint(pt->north);
+        Endpoint::releaseEndpoint(pt->south);
+        Tunnel::releaseTunnel(pt);
+    }
+    tunnels.clear();
+}
+
+// 与 TcpForwardService::doTunnelSoc -> onRead/onWrite 访问相同的字段: 由句柄取得端点,
+// 检查 tunnel 状态、对端水位与预算, 更新待发送数据量并检查发送链表
+void BM_TunnelHotPath(benchmark::State &state)
+{
+    std::vector<Tunnel_t *> tunnels;
+    auto handles = createTunnels(state.range(0), tunnels);
+
+    uint64_t touched = 0;
+    for (auto _ : state)
+    {
+        for (auto h : handles)
+        {
+            auto pe = Endpoint::fromHandle(h);
+            if (!pe || !pe->valid || pe->soc <= 0)
+            {
+                continue;
+            }
+            auto pt = (Tunnel_t *)pe->container;
+            if (pt->stat != TUNSTAT_ESTABLISHED || pt->mode != TUNMODE_BUFFER)
+            {
+                continue;
+            }
+            benchmark::DoNotOptimize(pt->budget);     // budgetQuota / chargeBudget
+            benchmark::DoNotOptimize(pe->pollEvents); // epollResetEndpointMode
+
+            // onRead: 数据移入对端的发送链表
+            auto peer = pe->peer;
+            if (!peer->bufferFull && peer->totalBufSize < peer->highWatermark)
+            {
+                peer->totalBufSize += 1024;
+                peer->sendListTail || (peer->sendListHead = peer->sendListTail = pe);
+                peer->bufferFull = peer->totalBufSize >= peer->highWatermark;
+            }
+
+            // onWrite: 发送本端链表中的数据
+            if (pe->sendListHead)
+            {
+                pe->totalBufSize -= std::min<int64_t>(pe->totalBufSize, 2048);
+                pe->totalBufSize || (pe->sendListHead = pe->sendListTail = nullptr);
+                pe->bufferFull && pe->totalBufSize <= pe->lowWatermark && (pe->bufferFull = false);
+            }
+            ++touched;
+        }
+    }
+    benchmark::DoNotOptimize(touched);
+    state.SetItemsProcessed(state.iterations() * handles.size());
+
+    releaseTunnels(tunnels);
+}
+BENCHMARK(BM_TunnelHotPath)->Arg(1000)->Arg(100000);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,239 @@
+/**
+ * @file tunnelRelay.cpp
+ * @author Liu Yu (source@liuyu.com)
+ * @brief Benchmark of the relay of a tcp tunnel: DynamicBuffer (buffer mode) vs RingBuffer (ring mode).
+ * @version 1.0
+ * @date 2020-03-02
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include <limits.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "../buffer/dynamicBuffer.h"
+#include "../buffer/ringBuffer.h"
+
+using namespace mapper::buffer;
+
+namespace
+{
+
+const int64_t HIGH_WATERMARK = 256 * 1024;  // 与 ring 模式的环形缓冲区容量相同
+const uint64_t SMALL_READ_RESERVE = 1024;   // TcpForwardService::SMALL_READ_RESERVE
+const uint64_t BUFFER_SIZE = 64 * 1024 * 1024;
+
+// client -> [in] relay [out] -> server, 均为非阻塞的 unix stream socket
+struct Tunnel_t
+{
+    int client;
+    int in;
+    int out;
+    int server;
+
+    bool open()
+    {
+        int a[2], b[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, a) ||
+            socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, b))
+        {
+            return false;
+        }
+        client = a[0];
+        in = a[1];
+        out = b[0];
+        server = b[1];
+        return true;
+    }
+    void close()
+    {
+        ::close(client);
+        ::close(in);
+        ::close(out);
+        ::close(server);
+    }
+};
+
+// buffer 模式: 接收至 DynamicBuffer 的当前空闲块并割取 (小数据量的读取追加至尾部数据块), 汇集发送链表后 writev
+struct BufferRelay_t
+{
+    DynamicBuffer *pBuffer = DynamicBuffer::allocDynamicBuffer(BUFFER_SIZE);
+    DynamicBuffer::BufBlk_t *head = nullptr;
+    DynamicBuffer::BufBlk_t *tail = nullptr;
+    int64_t total = 0;
+
+    ~BufferRelay_t() { DynamicBuffer::releaseDynamicBuffer(pBuffer); }
+
+    void read(int soc)
+    {
+        while (total < HIGH_WATERMARK)
+        {
+            bool append = tail && tail->getBufSize() - tail->dataSize >= DynamicBuffer::UNIT_ALLIGN_SIZE;
+            char *buf;
+            uint64_t room;
+            if (append)
+            {
+                buf = tail->buffer + tail->dataSize;
+                room = tail->getBufSize() - tail->dataSize;
+            }
+            else
+            {
+                auto pBlk = pBuffer->getCurBufBlk();
+                if (!pBlk)
+                {
+                    break;
+                }
+                buf = pBlk->buffer;
+                room = pBlk->getBufSize();
+            }
+
+            int nRet = recv(soc, buf, std::min<uint64_t>(room, HIGH_WATERMARK - total), 0);
+            if (nRet <= 0)
+            {
+                break;
+            }
+            total += nRet;
+            if (append)
+            {
+                tail->dataSize += nRet;
+                continue;
+            }
+
+            pBuffer->touch(buf, nRet);
+            uint64_t reserve = std::min<uint64_t>(std::min<uint64_t>(SMALL_READ_RESERVE, room), HIGH_WATERMARK - total);
+            auto pBlk = pBuffer->cut(std::max<uint64_t>(nRet, reserve));
+            pBlk->dataSize = nRet;
+            pBlk->sent = 0;
+            pBlk->next = nullptr;
+            tail ? (tail->next = pBlk) : (head = pBlk);
+            tail = pBlk;
+        }
+    }
+
+    void write(int soc)
+    {
+        iovec iov[IOV_MAX];
+        while (head)
+        {
+            int count = 0;
+            ssize_t gathered = 0;
+            for (auto p = head; p && count < IOV_MAX; p = p->next, ++count)
+            {
+                iov[count].iov_base = p->buffer + p->sent;
+                iov[count].iov_len = p->dataSize - p->sent;
+                gathered += iov[count].iov_len;
+            }
+            ssize_t nRet = writev(soc, iov, count);
+            if (nRet <= 0)
+            {
+                break;
+            }
+            total -= nRet;
+            for (auto left = nRet; left > 0;)
+            {
+                uint64_t size = head->dataSize - head->sent;
+                if ((uint64_t)left < size)
+                {
+                    head->sent += left;
+                    break;
+                }
+                left -= size;
+                auto next = head->next;
+                pBuffer->release(head);
+                head = next;
+            }
+            head || (tail = nullptr);
+            if (nRet < gathered)
+            {
+                break;
+            }
+        }
+    }
+};
+
+// ring 模式: 接收至环形缓冲区的连续空闲区域, 待发送数据在镜像映射中总是连续的, 一次 send
+struct RingRelay_t
+{
+    RingBuffer *pRing = RingBuffer::alloc(HIGH_WATERMARK);
+    int64_t total = 0;
+
+    RingRelay_t() { pRing->init(); }
+    ~RingRelay_t() { RingBuffer::release(pRing); }
+
+    void read(int soc)
+    {
+        while (total < HIGH_WATERMARK)
+        {
+            int nRet = recv(soc, pRing->getBuffer(), HIGH_WATERMARK - total, 0);
+            if (nRet <= 0)
+            {
+                break;
+            }
+            pRing->incDataSize(nRet);
+            total += nRet;
+        }
+    }
+
+    void write(int soc)
+    {
+        while (total > 0)
+        {
+            int nRet = send(soc, pRing->getData(), total, 0);
+            if (nRet <= 0)
+            {
+                break;
+            }
+            pRing->incFreeSize(nRet);
+            total -= nRet;
+        }
+    }
+};
+
+// 客户端每次写入 range(0) 字节, 经中继转发后由服务端读出, 直至全部 range(1) 字节到达
+template <typename Relay_t>
+void BM_Relay(benchmark::State &state)
+{
+    Tunnel_t tunnel;
+    if (!tunnel.open())
+    {
+        state.SkipWithError("socketpair fail");
+        return;
+    }
+    Relay_t relay;
+    uint64_t chunk = state.range(0);
+    uint64_t bytes = state.range(1);
+    std::vector<char> src(chunk, 'x');
+    std::vector<char> sink(HIGH_WATERMARK);
+
+    for (auto _ : state)
+    {
+        uint64_t written = 0, received = 0;
+        while (received < bytes)
+        {
+            if (written < bytes)
+            {
+                int nRet = send(tunnel.client, src.data(), std::min<uint64_t>(chunk, bytes - written), 0);
+                nRet > 0 && (written += nRet);
+            }
+            relay.read(tunnel.in);
+            relay.write(tunnel.out);
+            for (int nRet; (nRet = recv(tunnel.server, sink.data(), sink.size(), 0)) > 0;)
+            {
+                received += nRet;
+            }
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * bytes);
+
+    tunnel.close();
+}
+BENCHMARK_TEMPLATE(BM_Relay, BufferRelay_t)->Args({512, 1 << 20})->Args({16 << 10, 16 << 20})->Args({256 << 10, 64 << 20});
+BENCHMARK_TEMPLATE(BM_Relay, RingRelay_t)->Args({512, 1 << 20})->Args({16 << 10, 16 << 20})->Args({256 << 10, 64 << 20});
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -42,6 +42,8 @@ public:
     virtual bool writable() = 0;
     virtual bool defrag() = 0;
 
+    inline uint64_t getCapacity() { return capacity; }
+
     virtual bool valid();
     virtual std::string toStr();
 
@@ -1,7 +1,14 @@
 #include "dynamicBuffer.h"
 #include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <sstream>
 #include <spdlog/spdlog.h>
+#include "../utils/clock.h"
 
 #define ENABLE_PERFORMANCE_MODE
 #undef ENABLE_PERFORMANCE_MODE
@@ -19,29 +26,55 @@ const uint64_t DynamicBuffer::UNIT_ALLIGN_SIZE = 1 << UNIT_ALLIGN_BIT_WIDTH;
 const uint64_t DynamicBuffer::UNIT_ALLIGN_FIELD_MASK = UNIT_ALLIGN_SIZE - 1;
 const uint64_t DynamicBuffer::UNIT_ALLIGN_MASK = ~UNIT_ALLIGN_FIELD_MASK;
 const uint32_t DynamicBuffer::MIN_BLK_HEAD_BODY_LENGTH = UNIT_ALLIGN_SIZE;
+// MTU 大小的数据包, 以及 4K/16K/64K (GRO 合并后的数据包)
+const uint64_t DynamicBuffer::SLAB_CLASS_SIZES[SLAB_CLASS_COUNT] = {2048, 4096, 16384, 65536};
+const uint64_t DynamicBuffer::CHUNK_SIZE = 2 * 1024 * 1024;
+const uint64_t DynamicBuffer::FREE_HISTOGRAM_BOUNDS[FREE_HISTOGRAM_SIZE - 1] = {4096, 65536, 1048576};
 
 DynamicBuffer::DynamicBuffer()
-    : mBuffer(nullptr),
+    : mRemoteFreeList(nullptr),
+      mLockCount(0),
+      mLockContended(0),
+      mLockHoldTime(0),
+      mRemoteFrees(0),
+      mLockTime(0),
+      mLargestFree(0),
+      mFreeBlocks(0),
+      mAllocCount(0),
+      mAllocFailures(0),
+      mBuffer(nullptr),
+      mArena(nullptr),
+      mNow(0),
       mpFreePos(nullptr),
+      mTotalBuffer(0),
       mInUseCount(0),
       mTotalInUse(0),
       mTotalFree(0)
 {
+    for (auto &count : mFreeHistogram)
+    {
+        count.store(0);
+    }
 }
 
 DynamicBuffer::~DynamicBuffer()
 {
     if (mBuffer)
     {
-        free(mBuffer);
+        munmap(mBuffer, mTotalBuffer);
         mBuffer = nullptr;
     }
 };
 
-DynamicBuffer *DynamicBuffer::allocDynamicBuffer(uint64_t capacity)
+DynamicBuffer *DynamicBuffer::allocDynamicBuffer(uint64_t capacity, Policy_t policy, bool hugePage)
 {
     uint64_t alignedCapacity = sizeAllign(capacity);
     assert(alignedCapacity > MIN_BLK_HEAD_BODY_LENGTH);
+    if (hugePage)
+    {
+        // 大页映射的长度必须是大页大小的整数倍
+        alignedCapacity = (alignedCapacity + CHUNK_SIZE - 1) / CHUNK_SIZE * CHUNK_SIZE;
+    }
 
     DynamicBuffer *pDynamicBuffer = new DynamicBuffer();
     if (!pDynamicBuffer)
@@ -51,25 +84,64 @@ DynamicBuffer *DynamicBuffer::allocDynamicBuffer(uint64_t capacity)
     }
 
     spdlog::trace("[DynamicBuffer::allocDynamicBuffer] capacity: {}", alignedCapacity);
-    pDynamicBuffer->mBuffer = (char *)malloc(alignedCapacity);
-    if (pDynamicBuffer->mBuffer == nullptr)
+    void *p = MAP_FAILED;
+    if (hugePage)
+    {
+        // 大页由系统预留, 映射时即占用, 不使用 MAP_NORESERVE (否则预留不足时访问会触发 SIGBUS)
+        p = mmap(nullptr, alignedCapacity, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p == MAP_FAILED)
+        {
+            spdlog::warn("[DynamicBuffer::allocDynamicBuffer] map {} bytes of huge pages fail, fall back to normal pages. {} - {}",
+                         alignedCapacity, errno, strerror(errno));
+        }
+    }
+    if (p == MAP_FAILED)
+    {
+        p = mmap(nullptr, alignedCapacity, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        (p != MAP_FAILED && hugePage) && (madvise(p, alignedCapacity, MADV_HUGEPAGE), true);
+    }
+    if (p == MAP_FAILED)
     {
-        spdlog::error("[DynamicBuffer::allocDynamicBuffer] malloc {} bytes fail.",
-                      alignedCapacity);
+        spdlog::error("[DynamicBuffer::allocDynamicBuffer] map {} bytes fail. {} - {}",
+                      alignedCapacity, errno, strerror(errno));
         delete pDynamicBuffer;
         return nullptr;
     }
     else
     {
-        pDynamicBuffer->mpFreePos = (BufBlk_t *)pDynamicBuffer->mBuffer;
+        pDynamicBuffer->mBuffer = p;
+        pDynamicBuffer->mTotalBuffer = alignedCapacity;
+        pDynamicBuffer->mNow = utils::Clock::update() / 1000;
+        pDynamicBuffer->mChunkLastUse.resize((alignedCapacity + CHUNK_SIZE - 1) / CHUNK_SIZE, 0);
+        pDynamicBuffer->mArena = (char *)pDynamicBuffer->mBuffer;
+        pDynamicBuffer->initSlabs(policy == POLICY_SLAB ? alignedCapacity / SLAB_CAPACITY_RATIO : 0);
+        pDynamicBuffer->mTotalFree = (char *)pDynamicBuffer->mBuffer + alignedCapacity - pDynamicBuffer->mArena;
+
+        pDynamicBuffer->mpFreePos = (BufBlk_t *)pDynamicBuffer->mArena;
         pDynamicBuffer->mpFreePos->init(pDynamicBuffer);
-        pDynamicBuffer->mpFreePos->__innerBlockSize = alignedCapacity;
-        pDynamicBuffer->mTotalFree = alignedCapacity;
+        pDynamicBuffer->mpFreePos->__innerBlockSize = (char *)pDynamicBuffer->mBuffer + alignedCapacity - pDynamicBuffer->mArena;
+        pDynamicBuffer->updateFragmentation();
 
         return pDynamicBuffer;
     }
 }
 
+DynamicBuffer::Policy_t DynamicBuffer::parsePolicy(const string &policy)
+{
+    if (policy == "slab")
+    {
+        return POLICY_SLAB;
+    }
+    else if (policy != "firstFit")
+    {
+        spdlog::warn("[DynamicBuffer::parsePolicy] unknown policy[{}], use firstFit", policy);
+    }
+
+    return POLICY_FIRST_FIT;
+}
+
 void DynamicBuffer::releaseDynamicBuffer(DynamicBuffer *pDynamicBuffer)
 {
     pDynamicBuffer && (delete pDynamicBuffer, true);
@@ -97,6 +169,39 @@ string DynamicBuffer::dumpBlk(BufBlk_t *p)
     }
 }
 
+void DynamicBuffer::accumulate(Statistic_t &total, const Statistic_t &statistic)
+{
+    total.lockCount += statistic.lockCount;
+    total.lockContended += statistic.lockContended;
+    total.lockHoldTime += statistic.lockHoldTime;
+    total.remoteFrees += statistic.remoteFrees;
+    total.largestFree = max(total.largestFree, statistic.largestFree);
+    total.freeBlocks += statistic.freeBlocks;
+    for (uint32_t i = 0; i < FREE_HISTOGRAM_SIZE; ++i)
+    {
+        total.freeHistogram[i] += statistic.freeHistogram[i];
+    }
+    total.allocCount += statistic.allocCount;
+    total.allocFailures += statistic.allocFailures;
+}
+
+string DynamicBuffer::dumpStatistic(const Statistic_t &statistic)
+{
+    stringstream ss;
+
+    ss << "lk/lc/lt/rf:" << statistic.lockCount << "/" << statistic.lockContended
+       << "/" << statistic.lockHoldTime / 1000 << "us/" << statistic.remoteFrees
+       << ",lf/fb:" << statistic.largestFree / 1024 << "K/" << statistic.freeBlocks
+       << ",fh:" << statistic.freeHistogram[0];
+    for (uint32_t i = 1; i < FREE_HISTOGRAM_SIZE; ++i)
+    {
+        ss << "-" << statistic.freeHistogram[i];
+    }
+    ss << ",af:" << statistic.allocFailures << "/" << statistic.allocCount + statistic.allocFailures;
+
+    return ss.str();
+}
+
 char *DynamicBuffer::reserve(int req_size)
 {
     if (mpFreePos == nullptr)
@@ -132,7 +237,7 @@ char *DynamicBuffer::reserve(int req_size)
         else
         {
             // 2. 从头查找
-            p = (BufBlk_t *)mBuffer;
+            p = (BufBlk_t *)mArena;
             while (p != mpFreePos && (p->inUse || (p->__innerBlockSize < size)))
             {
                 // 因为 mpFreePos 是属于链表中的某一段
@@ -229,7 +334,7 @@ DynamicBuffer::BufBlk_t *DynamicBuffer::cutNoLock(uint64_t req_size)
         else
         {
             // 2. 从头查找
-            p = (BufBlk_t *)mBuffer;
+            p = (BufBlk_t *)mArena;
             while (p != mpFreePos && p->inUse)
             {
                 // 因为 mpFreePos 是属于链表中的某一段
@@ -263,16 +368,26 @@ DynamicBuffer::BufBlk_t *DynamicBuffer::cutNoLock(uint64_t req_size)
     assert(mTotalFree >= 0);
 #endif // ENABLE_PERFORMANCE_MODE
 
+    increase(mAllocCount);
+    markUsed(cutBlock);
+
     cutBlock->inUse = true;
     cutBlock->dataSize = req_size;
     cutBlock->sent = 0;
+    cutBlock->segSize = 0;
+    cutBlock->tag = 0;
 
     return cutBlock;
 }
 
-DynamicBuffer::BufBlk_t *DynamicBuffer::getBufBlk(uint64_t size)
+DynamicBuffer::BufBlk_t *DynamicBuffer::allocNoLock(uint64_t size)
 {
-    lock_guard<mutex> lg(mAccessMutex);
+    // 常用大小优先从 slab 分配
+    auto pBlk = slabAlloc(size);
+    if (pBlk)
+    {
+        return pBlk;
+    }
 
     if (reserve(size))
     {
@@ -280,25 +395,302 @@ DynamicBuffer::BufBlk_t *DynamicBuffer::getBufBlk(uint64_t size)
     }
     else
     {
+        increase(mAllocFailures);
         return nullptr;
     }
 }
 
-void DynamicBuffer::release(BufBlk_t *pBlk)
+void DynamicBuffer::bindOwner(bool bindNode)
 {
     lock_guard<mutex> lg(mAccessMutex);
+    mOwner = this_thread::get_id();
+
+    unsigned int cpu, node;
+    if (bindNode && syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+    {
+        // 尚未使用的页面在首次使用时分配在该节点上, 已使用的页面迁移至该节点
+        unsigned long nodeMask[16] = {0};
+        static const unsigned long BITS = sizeof(unsigned long) * 8;
+        if (node < sizeof(nodeMask) * 8)
+        {
+            nodeMask[node / BITS] = 1UL << (node % BITS);
+            if (syscall(SYS_mbind, mBuffer, mTotalBuffer, MPOL_PREFERRED,
+                        nodeMask, sizeof(nodeMask) * 8, MPOL_MF_MOVE))
+            {
+                spdlog::warn("[DynamicBuffer::bindOwner] bind buffer to node[{}] fail. {} - {}",
+                             node, errno, strerror(errno));
+            }
+        }
+    }
+}
+
+DynamicBuffer::BufBlk_t *DynamicBuffer::getBufBlk(uint64_t size)
+{
+    assert(!owned() || isOwner());
+    Locker_t locker(this);
+    reclaim();
+
+    return allocNoLock(size);
+}
+
+uint32_t DynamicBuffer::getBufBlks(const uint64_t *sizes, uint32_t count, BufBlk_t **pBlks)
+{
+    assert(!owned() || isOwner());
+    Locker_t locker(this);
+    reclaim();
+
+    uint32_t allocated = 0;
+    while (allocated < count && (pBlks[allocated] = allocNoLock(sizes[allocated])))
+    {
+        ++allocated;
+    }
+
+    return allocated;
+}
+
+void DynamicBuffer::release(BufBlk_t *pBlk)
+{
+    if (owned() && !isOwner())
+    {
+        // 由其他线程释放, 经无锁链表归还所有者线程
+        pushRemote(pBlk, pBlk, 1);
+        return;
+    }
+
+    Locker_t locker(this);
+    reclaim();
+    releaseNoLock(pBlk);
+}
+
+void DynamicBuffer::releaseList(BufBlk_t *pHead)
+{
+    if (pHead == nullptr)
+    {
+        return;
+    }
+
+    if (owned() && !isOwner())
+    {
+        // 整个链表一次归还
+        uint64_t count = 1;
+        auto pTail = pHead;
+        for (; pTail->next; pTail = pTail->next)
+        {
+            ++count;
+        }
+        pushRemote(pHead, pTail, count);
+        return;
+    }
+
+    Locker_t locker(this);
+    reclaim();
+    while (pHead)
+    {
+        auto next = pHead->next;
+        releaseNoLock(pHead);
+        pHead = next;
+    }
+}
+
+DynamicBuffer::Statistic_t DynamicBuffer::getStatistic()
+{
+    Statistic_t statistic;
+    statistic.lockCount = mLockCount.load(memory_order_relaxed);
+    statistic.lockContended = mLockContended.load(memory_order_relaxed);
+    statistic.lockHoldTime = mLockHoldTime.load(memory_order_relaxed);
+    statistic.remoteFrees = mRemoteFrees.load(memory_order_relaxed);
+    statistic.largestFree = mLargestFree.load(memory_order_relaxed);
+    statistic.freeBlocks = mFreeBlocks.load(memory_order_relaxed);
+    for (uint32_t i = 0; i < FREE_HISTOGRAM_SIZE; ++i)
+    {
+        statistic.freeHistogram[i] = mFreeHistogram[i].load(memory_order_relaxed);
+    }
+    statistic.allocCount = mAllocCount.load(memory_order_relaxed);
+    statistic.allocFailures = mAllocFailures.load(memory_order_relaxed);
+
+    return statistic;
+}
+
+void DynamicBuffer::resetStatistic()
+{
+    mLockCount.store(0, memory_order_relaxed);
+    mLockContended.store(0, memory_order_relaxed);
+    mLockHoldTime.store(0, memory_order_relaxed);
+    mRemoteFrees.store(0, memory_order_relaxed);
+    mAllocCount.store(0, memory_order_relaxed);
+    mAllocFailures.store(0, memory_order_relaxed);
+}
+
+void DynamicBuffer::updateFragmentation()
+{
+    uint64_t largest = 0;
+    uint64_t count = 0;
+    uint64_t histogram[FREE_HISTOGRAM_SIZE] = {0};
+    {
+        Locker_t locker(this);
+        reclaim();
+
+        for (auto p = (BufBlk_t *)mArena; p; p = p->__innerNext)
+        {
+            if (p->inUse)
+            {
+                continue;
+            }
 
+            ++count;
+            largest = max(largest, p->__innerBlockSize);
+
+            uint32_t i = 0;
+            while (i < FREE_HISTOGRAM_SIZE - 1 && p->__innerBlockSize >= FREE_HISTOGRAM_BOUNDS[i])
+            {
+                ++i;
+            }
+            ++histogram[i];
+        }
+    }
+
+    mLargestFree.store(largest, memory_order_relaxed);
+    mFreeBlocks.store(count, memory_order_relaxed);
+    for (uint32_t i = 0; i < FREE_HISTOGRAM_SIZE; ++i)
+    {
+        mFreeHistogram[i].store(histogram[i], memory_order_relaxed);
+    }
+}
+
+void DynamicBuffer::trim(time_t curTime, uint32_t quietPeriod)
+{
+    Locker_t locker(this);
+    reclaim();
+
+    mNow = curTime;
+
+    // 空闲块的头部之后、整块位于其中的 chunk 均可归还; 再次分配时由内核重新提交 (清零的) 内存
+    uint64_t trimmed = 0;
+    for (auto p = (BufBlk_t *)mArena; p; p = p->__innerNext)
+    {
+        if (p->inUse)
+        {
+            continue;
+        }
+
+        uint64_t begin = ((char *)p - (char *)mBuffer + BUFBLK_HEAD_SIZE + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        uint64_t end = ((char *)p - (char *)mBuffer + p->__innerBlockSize) / CHUNK_SIZE;
+        for (uint64_t i = begin; i < end; ++i)
+        {
+            if (mChunkLastUse[i] && mChunkLastUse[i] + quietPeriod <= curTime)
+            {
+                madvise((char *)mBuffer + i * CHUNK_SIZE, CHUNK_SIZE, MADV_DONTNEED);
+                mChunkLastUse[i] = 0;
+                trimmed += CHUNK_SIZE;
+            }
+        }
+    }
+
+    trimmed && (spdlog::debug("[DynamicBuffer::trim] return {} bytes", trimmed), true);
+}
+
+DynamicBuffer::BufBlk_t *DynamicBuffer::slideDown(BufBlk_t *p)
+{
+    auto pFree = p->__innerPrev;
+    auto freeSize = pFree->__innerBlockSize;
+    auto pPrev = pFree->__innerPrev;
+    auto pNext = p->__innerNext;
+    bool isFreePos = mpFreePos == pFree;
+
+    assert(p->inUse && !pFree->inUse);
+
+    // 数据块 (含头部) 整体前移至空闲块处
+    auto pNew = (BufBlk_t *)pFree;
+    memmove(pNew, p, p->__innerBlockSize);
+    pNew->__innerPrev = pPrev;
+    pPrev && (pPrev->__innerNext = pNew);
+
+    // 空闲块移至数据块之后
+    auto pNewFree = (BufBlk_t *)((char *)pNew + pNew->__innerBlockSize);
+    pNewFree->init(this);
+    pNewFree->__innerBlockSize = freeSize;
+    pNewFree->__innerPrev = pNew;
+    pNewFree->__innerNext = pNext;
+    pNext && (pNext->__innerPrev = pNewFree);
+    pNew->__innerNext = pNewFree;
+
+    isFreePos && (mpFreePos = pNewFree);
+    markUsed(pNew);
+
+    // 与后面的空闲块合并
+    mergeNext(pNewFree);
+
+    return pNew;
+}
+
+void DynamicBuffer::reclaimRemote()
+{
+    assert(!owned() || isOwner());
+
+    auto p = mRemoteFreeList.exchange(nullptr, memory_order_acquire);
+    while (p)
+    {
+        auto next = p->next;
+        releaseNoLock(p);
+        p = next;
+    }
+}
+
+void DynamicBuffer::pushRemote(BufBlk_t *pHead, BufBlk_t *pTail, uint64_t count)
+{
+    auto head = mRemoteFreeList.load(memory_order_relaxed);
+    do
+    {
+        pTail->next = head;
+    } while (!mRemoteFreeList.compare_exchange_weak(head, pHead,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+
+    mRemoteFrees.fetch_add(count, memory_order_relaxed);
+}
+
+void DynamicBuffer::lock()
+{
+    if (!mAccessMutex.try_lock())
+    {
+        mAccessMutex.lock();
+        mLockContended.fetch_add(1, memory_order_relaxed);
+    }
+    mLockCount.fetch_add(1, memory_order_relaxed);
+
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    mLockTime = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void DynamicBuffer::unlock()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    mLockHoldTime.fetch_add(ts.tv_sec * 1000000000ULL + ts.tv_nsec - mLockTime, memory_order_relaxed);
+
+    mAccessMutex.unlock();
+}
+
+void DynamicBuffer::releaseNoLock(BufBlk_t *pBlk)
+{
 #ifdef ENABLE_PERFORMANCE_MODE
     assert(pBlk && pBlk->inUse);
     assert(pBlk->__dynamicBufferObj == this);
 #endif // ENABLE_PERFORMANCE_MODE
 
     --mInUseCount;
-
-    mTotalFree += pBlk->__innerBlockSize;
     mTotalInUse -= pBlk->__innerBlockSize;
 
     pBlk->inUse = false;
+    if ((char *)pBlk < mArena)
+    {
+        // slab 数据块, 归还所属级别
+        slabFree(pBlk);
+        return;
+    }
+    mTotalFree += pBlk->__innerBlockSize;
+
     if (mpFreePos == nullptr)
     {
         // 调整 mpFreePos
@@ -319,10 +711,89 @@ void DynamicBuffer::release(BufBlk_t *pBlk)
 #endif // ENABLE_PERFORMANCE_MODE
 }
 
+void DynamicBuffer::initSlabs(uint64_t capacity)
+{
+    // 每一级分得相同大小的区域, 数据块按需切出; 剩余部分用于首次适配
+    for (uint32_t i = 0; i < SLAB_CLASS_COUNT; ++i)
+    {
+        auto &slabClass = mSlabClasses[i];
+        slabClass.blockSize = sizeAllign(BUFBLK_HEAD_SIZE + SLAB_CLASS_SIZES[i]);
+        slabClass.freeList = nullptr;
+        slabClass.carvePos = mArena;
+
+        mArena += capacity / SLAB_CLASS_COUNT / slabClass.blockSize * slabClass.blockSize;
+        slabClass.carveEnd = mArena;
+    }
+
+    spdlog::trace("[DynamicBuffer::initSlabs] slab size: {}", mArena - (char *)mBuffer);
+}
+
+DynamicBuffer::BufBlk_t *DynamicBuffer::slabAlloc(uint64_t size)
+{
+    for (uint32_t i = 0; i < SLAB_CLASS_COUNT; ++i)
+    {
+        if (SLAB_CLASS_SIZES[i] < size)
+        {
+            continue;
+        }
+
+        // 只使用可容纳 size 的最小一级, 该级已用完时由首次适配分配
+        auto &slabClass = mSlabClasses[i];
+        auto p = slabClass.freeList;
+        if (p)
+        {
+            slabClass.freeList = p->next;
+        }
+        else if (slabClass.carvePos < slabClass.carveEnd)
+        {
+            // 空闲链表为空, 从该级区域中切出新的数据块
+            p = (BufBlk_t *)slabClass.carvePos;
+            p->init(this);
+            p->__innerBlockSize = slabClass.blockSize;
+            slabClass.carvePos += slabClass.blockSize;
+        }
+        else
+        {
+            return nullptr;
+        }
+
+        mTotalInUse += p->__innerBlockSize;
+        ++mInUseCount;
+
+        increase(mAllocCount);
+
+        p->inUse = true;
+        p->next = nullptr;
+        p->dataSize = size;
+        p->sent = 0;
+        p->segSize = 0;
+        p->tag = 0;
+
+        return p;
+    }
+
+    return nullptr;
+}
+
+void DynamicBuffer::slabFree(BufBlk_t *pBlk)
+{
+    for (auto &slabClass : mSlabClasses)
+    {
+        if (slabClass.blockSize == pBlk->__innerBlockSize)
+        {
+            pBlk->next = slabClass.freeList;
+            slabClass.freeList = pBlk;
+            return;
+        }
+    }
+
+    assert(false);
+}
+
 bool DynamicBuffer::check()
 {
     // check link
-    auto p = (BufBlk_t *)mBuffer;
+    auto p = (BufBlk_t *)mArena;
     while (p)
     {
         if (!p->inUse &&
@@ -14,10 +14,14 @@
 
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <time.h>
+#include <atomic>
 #include <list>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <tuple>
+#include <vector>
 
 namespace mapper
 {
@@ -48,6 +52,8 @@ public:
         sockaddr_in dstAddr;
         uint64_t dataSize;
         uint64_t sent;
+        uint32_t segSize; // udp: size of each coalesced datagram (GRO/GSO), 0: single datagram
+        uint64_t tag;     // user data, udp: handle of the service endpoint which received the packet
         char buffer[0];
 
         inline void init(DynamicBuffer *obj)
@@ -64,46 +70,231 @@ public:
             dstAddr = {0};
             dataSize = 0;
             sent = 0;
+            segSize = 0;
+            tag = 0;
         }
         inline uint64_t getBufSize() { return __innerBlockSize - BUFBLK_HEAD_SIZE; }
     };
 
+    static const uint32_t FREE_HISTOGRAM_SIZE = 4;
+    static const uint64_t FREE_HISTOGRAM_BOUNDS[FREE_HISTOGRAM_SIZE - 1]; // 各区间空闲块大小的上限
+
+    struct Statistic_t
+    {
+        uint64_t lockCount;     // 加锁次数
+        uint64_t lockContended; // 其中需要等待的次数
+        uint64_t lockHoldTime;  // 锁持有时间, 单位: 纳秒
+        uint64_t remoteFrees;   // 非所有者线程经无锁链表归还的数据块数
+
+        // fragmentation: 首次适配区域最近一次 updateFragmentation() 时的空闲块分布
+        uint64_t largestFree;                       // 最大空闲块大小
+        uint64_t freeBlocks;                        // 空闲块个数
+        uint64_t freeHistogram[FREE_HISTOGRAM_SIZE]; // 按大小区间统计的空闲块个数
+        uint64_t allocCount;                        // 分配成功次数
+        uint64_t allocFailures;                     // 分配失败次数
+    };
+
+    enum Policy_t
+    {
+        POLICY_FIRST_FIT = 0, // 全部缓冲区以首次适配方式分配, 释放时与相邻空闲块合并
+        POLICY_SLAB           // 常用大小由分级 slab 分配, 其余大小仍以首次适配方式分配
+    };
+
 protected:
+    static const uint32_t SLAB_CLASS_COUNT = 4;
+    static const uint64_t SLAB_CLASS_SIZES[SLAB_CLASS_COUNT]; // 各级数据块可容纳的数据大小
+    static const uint32_t SLAB_CAPACITY_RATIO = 2;             // 1/SLAB_CAPACITY_RATIO 的缓冲区用作 slab
+    static const uint64_t CHUNK_SIZE;                          // 大页大小, 也是归还空闲内存的单位
+
+    // 各级的数据块在空闲链表为空时才从该级区域中依次切出, 未用到的区域不会被写入 (保持 MAP_NORESERVE 的按需提交)
+    struct SlabClass_t
+    {
+        uint64_t blockSize; // 数据块大小, 包含头部
+        BufBlk_t *freeList; // 空闲数据块, 由 next 链接
+        char *carvePos;     // 该级区域中尚未切出的部分
+        char *carveEnd;
+    };
+
     DynamicBuffer();
     virtual ~DynamicBuffer();
 
 public:
-    static DynamicBuffer *allocDynamicBuffer(uint64_t capacity);
+    /**
+     * 缓冲区以 mmap(MAP_NORESERVE) 保留地址空间, 内存在首次使用时才由内核提交;
+     * hugePage 为 true 时优先使用 MAP_HUGETLB, 失败时退回普通页并建议内核使用透明大页
+     */
+    static DynamicBuffer *allocDynamicBuffer(uint64_t capacity, Policy_t policy = POLICY_FIRST_FIT, bool hugePage = false);
+    static Policy_t parsePolicy(const std::string &policy);
     static void releaseDynamicBuffer(DynamicBuffer *pDynamicBuffer);
     static std::string dumpBlk(BufBlk_t *p);
+    // 汇总多个缓存的统计数据 (最大空闲块取最大值, 其余累加)
+    static void accumulate(Statistic_t &total, const Statistic_t &statistic);
+    static std::string dumpStatistic(const Statistic_t &statistic);
+
+    /**
+     * 绑定所有者线程 (由所有者线程调用):
+     * 之后所有者线程的分配/释放不再加锁; 其他线程只能释放数据块,
+     * 释放的数据块经无锁链表归还, 由所有者线程在下一次分配/释放时回收;
+     * bindNode 为 true 时, 缓冲区内存优先分配在所有者线程当前所在的 NUMA 节点上
+     */
+    void bindOwner(bool bindNode = false);
 
     inline bool empty() { return mpFreePos; }
-    inline BufBlk_t *getCurBufBlk() { return mpFreePos; }
+    // 首次适配区域的空闲大小 (不含 slab)
+    inline int64_t freeSize() { return mTotalFree; }
+    // 取当前空闲块用于接收, 无空闲块时计为一次分配失败
+    inline BufBlk_t *getCurBufBlk()
+    {
+        reclaim();
+        mpFreePos || (increase(mAllocFailures), true);
+        return mpFreePos;
+    }
+    // 数据写入 getCurBufBlk() 后未经割取 (如接收后随即发出) 时调用, 记录写入的内存以便 trim() 归还
+    inline void touch(const char *p, uint64_t size) { size && (markUsed(p, size), true); }
+    // 是否有空闲块 (回收其他线程释放的数据块后), 不计入分配失败, 供轮询使用
+    inline bool hasFreeBlk()
+    {
+        reclaim();
+        return mpFreePos;
+    }
     char *reserve(int size);
     inline BufBlk_t *cut(uint64_t size)
     {
-        std::lock_guard<std::mutex> lg(mAccessMutex);
+        Locker_t locker(this);
         return cutNoLock(size);
     }
     BufBlk_t *cutNoLock(uint64_t size);
     BufBlk_t *getBufBlk(uint64_t size);
+    // 批量分配 (一次加锁及回收), 依次分配 sizes[i] 大小的数据块至 pBlks[i], 遇到分配失败即停止, 返回分配的个数
+    uint32_t getBufBlks(const uint64_t *sizes, uint32_t count, BufBlk_t **pBlks);
     void release(BufBlk_t *pBuffer);
+    // 批量释放由 next 链接的数据块, 以 nullptr 结束
+    void releaseList(BufBlk_t *pHead);
+
+    Statistic_t getStatistic();
+    void resetStatistic();
+
+    // 统计首次适配区域的空闲块分布 (遍历整个区域), 由所有者线程定期调用
+    void updateFragmentation();
+    // 将持续 quietPeriod 秒未被分配的空闲内存 (以 CHUNK_SIZE 为单位) 归还系统, 由所有者线程定期调用;
+    // curTime 为单调时钟秒数 (见 utils::Clock)
+    void trim(time_t curTime, uint32_t quietPeriod);
+    // 最大空闲块不足空闲总量的一半时, 认为碎片化
+    inline bool fragmented()
+    {
+        return mFreeBlocks.load(std::memory_order_relaxed) > 1 &&
+               (int64_t)mLargestFree.load(std::memory_order_relaxed) * 2 < mTotalFree;
+    }
+
+    /**
+     * 碎片整理 (仅限所有者线程或未绑定时调用):
+     * 按地址顺序将未发送过 (sent == 0) 的数据块前移至其前面的空闲块, 使空闲块逐步后移合并;
+     * 数据块地址改变后调用 fixup(oldBlk, newBlk), 由使用者修正指向该数据块的指针。
+     * 移动数据量达到 budget 后停止, 返回移动的数据量
+     */
+    template <typename F>
+    uint64_t defragment(uint64_t budget, F &&fixup)
+    {
+        Locker_t locker(this);
+        reclaim();
+
+        uint64_t moved = 0;
+        for (auto p = (BufBlk_t *)mArena; p && moved < budget; p = p->__innerNext)
+        {
+            auto pFree = p->__innerPrev;
+            if (!p->inUse || p->sent || !pFree || pFree->inUse)
+            {
+                continue;
+            }
+
+            moved += p->__innerBlockSize;
+            auto pNew = slideDown(p);
+            fixup(p, pNew);
+            p = pNew;
+        }
+
+        return moved;
+    }
 
     bool check();
 
 protected:
+    // 未绑定所有者线程时加锁, 并记录锁的统计数据
+    class Locker_t
+    {
+    public:
+        inline Locker_t(DynamicBuffer *pBuffer) : mpBuffer(pBuffer->owned() ? nullptr : pBuffer)
+        {
+            mpBuffer && (mpBuffer->lock(), true);
+        }
+        inline ~Locker_t() { mpBuffer && (mpBuffer->unlock(), true); }
+
+    protected:
+        DynamicBuffer *mpBuffer;
+    };
+
     static uint64_t sizeAllign(const uint64_t size);
 
+    inline bool owned() { return mOwner != std::thread::id(); }
+    inline bool isOwner() { return mOwner == std::this_thread::get_id(); }
+    inline void reclaim()
+    {
+        mRemoteFreeList.load(std::memory_order_relaxed) && (reclaimRemote(), true);
+    }
+    void reclaimRemote();
+    void pushRemote(BufBlk_t *pHead, BufBlk_t *pTail, uint64_t count);
+    BufBlk_t *allocNoLock(uint64_t size);
+    void releaseNoLock(BufBlk_t *pBuffer);
+    BufBlk_t *slideDown(BufBlk_t *p);
+    inline void markUsed(const void *p, uint64_t size)
+    {
+        uint64_t offset = (const char *)p - (char *)mBuffer;
+        for (uint64_t i = offset / CHUNK_SIZE; i <= (offset + size - 1) / CHUNK_SIZE; ++i)
+        {
+            mChunkLastUse[i] = mNow;
+        }
+    }
+    inline void markUsed(BufBlk_t *p) { markUsed(p, p->__innerBlockSize); }
+    // 计数只由所有者线程 (或持锁线程) 修改, 无需原子加
+    static inline void increase(std::atomic<uint64_t> &counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    void initSlabs(uint64_t capacity);
+    BufBlk_t *slabAlloc(uint64_t size);
+    void slabFree(BufBlk_t *pBlk);
+    void lock();
+    void unlock();
+
     void mergePrev(BufBlk_t *p);
     void mergeNext(BufBlk_t *p);
 
+    std::thread::id mOwner;
+    std::atomic<BufBlk_t *> mRemoteFreeList;
+
+    // statistic
+    std::atomic<uint64_t> mLockCount;
+    std::atomic<uint64_t> mLockContended;
+    std::atomic<uint64_t> mLockHoldTime;
+    std::atomic<uint64_t> mRemoteFrees;
+    uint64_t mLockTime; // 本次加锁的时间
+    std::atomic<uint64_t> mLargestFree;
+    std::atomic<uint64_t> mFreeBlocks;
+    std::atomic<uint64_t> mFreeHistogram[FREE_HISTOGRAM_SIZE];
+    std::atomic<uint64_t> mAllocCount;
+    std::atomic<uint64_t> mAllocFailures;
+
     std::mutex mAccessMutex;
     void *mBuffer;
+    char *mArena; // 首次适配区域, slab 位于其前
+    time_t mNow;  // 由 trim() 更新的粗粒度时间
+    std::vector<time_t> mChunkLastUse; // 各 chunk 最近一次被分配的时间, 0: 未使用或已归还
+    SlabClass_t mSlabClasses[SLAB_CLASS_COUNT];
     BufBlk_t *mpFreePos;
     int64_t mTotalBuffer;
     int32_t mInUseCount;
     int64_t mTotalInUse;
-    int64_t mTotalFree;
+    int64_t mTotalFree; // 首次适配区域
 };
 
 } // namespace buffer
@@ -54,6 +54,9 @@ RingBuffer::~RingBuffer()
 
 RingBuffer *RingBuffer::alloc(uint32_t capacity)
 {
+    // align capacity to system page size, both mappings must cover whole pages
+    capacity = alignToPageSize(capacity);
+
     RingBuffer *pRingBuffer = new RingBuffer(capacity);
     if (!pRingBuffer)
     {
@@ -61,8 +64,6 @@ RingBuffer *RingBuffer::alloc(uint32_t capacity)
         return nullptr;
     }
     if ([&]() -> bool {
-            // align capacity to system page size;
-            capacity = alignToPageSize(capacity);
             spdlog::trace("[RingBuffer::createBuffer] capacity: {}", capacity);
 
             // create fd for memory block
@@ -102,7 +103,7 @@ RingBuffer *RingBuffer::alloc(uint32_t capacity)
                     }
                     if ([&]() -> bool {
                             if (mmap(pRingBuffer->buffer, capacity,
-                                     PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED | MAP_LOCKED,
+                                     PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED,
                                      fd,
                                      0) !=
                                 pRingBuffer->buffer)
@@ -112,7 +113,7 @@ RingBuffer *RingBuffer::alloc(uint32_t capacity)
                                 return false;
                             }
                             if (mmap(pRingBuffer->buffer + capacity, capacity,
-                                     PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED | MAP_LOCKED, fd, 0) !=
+                                     PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED, fd, 0) !=
                                 pRingBuffer->buffer + capacity)
                             {
                                 spdlog::error("[RingBuffer::createBuffer] map fd to second virtual space fail. {}: {}.",
@@ -17,28 +17,13 @@ namespace mapper
 namespace link
 {
 
-uint32_t Endpoint::gFreeCount = 0;
-uint32_t Endpoint::gInUseCount = 0;
-
-std::list<Endpoint_t *> Endpoint::gFreeList;
-
 Endpoint_t *Endpoint::getEndpoint(Protocol_t protocol, Direction_t direction, Type_t type)
 {
-    if (gFreeList.empty())
-    {
-        batchAlloc(BATCH_ALLOC_COUNT);
-    }
-
-    Endpoint_t *pe = gFreeList.front();
+    Endpoint_t *pe = Pool::alloc();
     if (pe)
     {
-        gFreeList.pop_front();
-
-        --gFreeCount;
-        ++gInUseCount;
-        assert(gFreeCount >= 0);
-
-        pe->init(protocol, direction, type);
+        pe->init(direction, type);
+        cold(pe)->init(protocol);
     }
 
     return pe;
@@ -48,24 +33,7 @@ void Endpoint::releaseEndpoint(Endpoint_t *pe)
 {
     assert(pe);
 
-    gFreeList.push_front(pe);
-
-    ++gFreeCount;
-    --gInUseCount;
-    assert(gInUseCount >= 0);
-
-    if (gFreeCount > RELEASE_THRESHOLD)
-    {
-        for (auto i = BUFFER_SIZE; i < RELEASE_THRESHOLD; ++i)
-        {
-            auto pe = gFreeList.front();
-            gFreeList.pop_front();
-            delete pe;
-            --gFreeCount;
-        }
-
-        assert(gFreeCount == BUFFER_SIZE);
-    }
+    Pool::release(pe);
 }
 
 bool Endpoint::appendToSendList(Endpoint_t *pe, DynamicBuffer::BufBlk_t *pBufBlk)
@@ -110,16 +78,5 @@ uint32_t Endpoint::sendListLength(const Endpoint_t *pe)
     return length;
 }
 
-void Endpoint::batchAlloc(const uint32_t count)
-{
-    for (auto i = 0; i < count; ++i) {
-        auto pe = new Endpoint_t;
-        if (pe) {
-            gFreeList.push_front(pe);
-            ++gFreeCount;
-        }
-    }
-}
-
 } // namespace link
 } // namespace mapper
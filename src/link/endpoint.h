@@ -2,10 +2,10 @@
 #define __MAPPER_LINK_ENDPOINT_H__
 
 #include <netinet/in.h> // for sockaddr_in
-#include <list>
 #include <string>
 #include "type.h"
 #include "../buffer/dynamicBuffer.h"
+#include "../utils/slabPool.h"
 
 using namespace mapper::buffer;
 
@@ -16,9 +16,7 @@ namespace link
 
 class Endpoint
 {
-    static const uint32_t BUFFER_SIZE = 1 << 10;
-    static const uint32_t RELEASE_THRESHOLD = BUFFER_SIZE + 1 << 8;
-    static const uint32_t BATCH_ALLOC_COUNT = 1 << 7;
+    typedef utils::SlabPool<Endpoint_t, EndpointCold_t> Pool;
 
 protected:
     Endpoint(){};
@@ -31,13 +29,13 @@ public:
     static bool appendToSendList(Endpoint_t *pe, DynamicBuffer::BufBlk_t *pBufBlk);
     static uint32_t sendListLength(const Endpoint_t *pe);
 
-protected:
-    static void batchAlloc(const uint32_t count);
-
-    static uint32_t gFreeCount;
-    static uint32_t gInUseCount;
-
-    static std::list<Endpoint_t *> gFreeList;
+    // 对象池按线程划分, 预先分配当前线程的 count 个对象
+    static inline bool prewarm(uint32_t count) { return Pool::prewarm(count); }
+    // 句柄 (序号 + 代数) 用于 epoll_event.data.u64, 端点释放后 fromHandle() 返回 nullptr
+    static inline uint64_t handle(Endpoint_t *pe) { return Pool::handle(pe); }
+    static inline Endpoint_t *fromHandle(uint64_t h) { return Pool::fromHandle(h); }
+    // 建立/关闭连接时才访问的字段
+    static inline EndpointCold_t *cold(const Endpoint_t *pe) { return Pool::cold(pe); }
 };
 
 } // namespace link
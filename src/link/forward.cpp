@@ -17,6 +17,7 @@ const regex Forward::REG_FORWARD_SETTING = regex(R"(^\s*)"
                                                  R"((\d{1,5})\s*:)"                      // service port
                                                  R"(\s*([A-Za-z0-9._-]+)\s*:)"           // target host
                                                  R"(\s*(\d{1,5}))"                       // target port
+                                                 R"((\s*\?\s*([A-Za-z0-9=&._-]*))?)"     // options
                                                  R"(\s*$)");
 
 Forward::Forward(const std::string &protocol,
@@ -39,6 +40,7 @@ Forward::Forward(const Forward &src)
          src.service,
          src.targetHost,
          src.targetService);
+    options = src.options;
 }
 
 Forward::Forward(const Forward *src)
@@ -48,6 +50,7 @@ Forward::Forward(const Forward *src)
          src->service,
          src->targetHost,
          src->targetService);
+    options = src->options;
 }
 
 Forward &Forward::operator=(const Forward &src)
@@ -57,6 +60,9 @@ Forward &Forward::operator=(const Forward &src)
          src.service,
          src.targetHost,
          src.targetService);
+    options = src.options;
+
+    return *this;
 }
 
 void Forward::init(const std::string &protocol,
@@ -114,12 +120,13 @@ bool Forward::parse(string &setting)
             //     spdlog::debug("[asdf] match[{}]: {}", i++, item.str());
             // }
 
-            assert(match.size() == 8);
+            assert(match.size() == 10);
             string strProtocol = match[3];
             string strInterface = match[4];
             string strService = match[5];
             string strIp = match[6];
             string strPort = match[7];
+            string strOptions = match[9];
 
             strProtocol = strProtocol.empty() ? "tcp" : strProtocol;    // default protocl: tcp
             strInterface = strInterface.empty() ? "any" : strInterface; // default interface: any
@@ -138,6 +145,25 @@ bool Forward::parse(string &setting)
             }
             else
             {
+                // options: name=value&name=value
+                options.clear();
+                stringstream ss(strOptions);
+                string option;
+                while (getline(ss, option, '&'))
+                {
+                    if (option.empty())
+                    {
+                        continue;
+                    }
+                    auto pos = option.find('=');
+                    if (pos == 0 || pos == string::npos || pos == option.size() - 1)
+                    {
+                        spdlog::error("[Forward::parse] drop invalid mapping data(option[{}]): {}", option, setting);
+                        return false;
+                    }
+                    options[option.substr(0, pos)] = option.substr(pos + 1);
+                }
+
                 init(strProtocol, strInterface, strService, strIp, strPort);
                 return true;
             }
@@ -163,10 +189,26 @@ string Forward::toStr()
        << interface << ":"
        << service << ":"
        << targetHost << ":"
-       << targetService << "]";
+       << targetService;
+    if (!options.empty())
+    {
+        char sep = '?';
+        for (auto &option : options)
+        {
+            ss << sep << option.first << "=" << option.second;
+            sep = '&';
+        }
+    }
+    ss << "]";
 
     return ss.str();
 }
 
+string Forward::getOption(const string &name, const string &defaultValue) const
+{
+    auto it = options.find(name);
+    return it == options.end() ? defaultValue : it->second;
+}
+
 } // namespace link
 } // namespace mapper
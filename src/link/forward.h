@@ -12,6 +12,7 @@
 #ifndef __MAPPER_LINK_FORWARD_H__
 #define __MAPPER_LINK_FORWARD_H__
 
+#include <map>
 #include <memory>
 #include <regex>
 #include <string>
@@ -49,11 +50,14 @@ public:
     bool parse(std::string &setting);
     std::string toStr();
 
+    std::string getOption(const std::string &name, const std::string &defaultValue = "") const;
+
     std::string protocol;
     std::string interface;
     std::string service;
     std::string targetHost;
     std::string targetService;
+    std::map<std::string, std::string> options; // optional per-forward settings: ?name=value&name=value
 };
 
 } // namespace link
@@ -0,0 +1,186 @@
+#include "poller.h"
+#include <string.h>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+#include "endpoint.h"
+#include "uringPoller.h"
+
+using namespace std;
+
+namespace mapper
+{
+namespace link
+{
+
+Poller *Poller::create(Backend_t backend, std::atomic<uint64_t> *pCtlCount)
+{
+    Poller *pPoller = nullptr;
+    if (backend == BACKEND_IO_URING)
+    {
+        pPoller = UringPoller::create();
+        !pPoller && (spdlog::warn("[Poller::create] io_uring is not available, fall back to epoll"), true);
+    }
+
+    pPoller = pPoller ? pPoller : EpollPoller::create();
+    pPoller && (pPoller->mpCtlCount = pCtlCount);
+
+    return pPoller;
+}
+
+void Poller::release(Poller *pPoller)
+{
+    pPoller && (delete pPoller, true);
+}
+
+Poller::Backend_t Poller::parseBackend(const string &backend)
+{
+    if (backend == "io_uring")
+    {
+        return BACKEND_IO_URING;
+    }
+    else if (backend != "epoll")
+    {
+        spdlog::warn("[Poller::parseBackend] unknown backend[{}], use epoll", backend);
+    }
+
+    return BACKEND_EPOLL;
+}
+
+EpollPoller::~EpollPoller()
+{
+    mEpollfd && (::close(mEpollfd), (mEpollfd = 0));
+}
+
+EpollPoller *EpollPoller::create()
+{
+    auto pPoller = new EpollPoller();
+
+    if ((pPoller->mEpollfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+    {
+        spdlog::error("[EpollPoller::create] Failed to create epoll fd. {} - {}",
+                      errno, strerror(errno));
+        pPoller->mEpollfd = 0;
+        delete pPoller;
+        return nullptr;
+    }
+
+    return pPoller;
+}
+
+bool EpollPoller::add(Endpoint_t *pe, uint32_t events)
+{
+    struct epoll_event event;
+    event.data.u64 = Endpoint::handle(pe);
+    event.events = events;
+
+    discard(pe);
+    countCtl();
+    if (epoll_ctl(mEpollfd, EPOLL_CTL_ADD, pe->soc, &event))
+    {
+        return false;
+    }
+    pe->pollEvents = events;
+
+    return true;
+}
+
+bool EpollPoller::modify(Endpoint_t *pe, uint32_t events)
+{
+    if (pe->pollEvents == events)
+    {
+        return true;
+    }
+
+    // 本轮首次修改时记录已注册的掩码
+    if (pe->pollState != POLLSTAT_DIRTY)
+    {
+        mPending.push_back({Endpoint::handle(pe), pe->pollEvents});
+        pe->pollState = POLLSTAT_DIRTY;
+    }
+    pe->pollEvents = events;
+
+    return true;
+}
+
+bool EpollPoller::remove(Endpoint_t *pe)
+{
+    discard(pe);
+    countCtl();
+    return epoll_ctl(mEpollfd, EPOLL_CTL_DEL, pe->soc, nullptr) == 0;
+}
+
+int EpollPoller::wait(epoll_event *events, int maxEvents, int timeout)
+{
+    flush();
+
+    int nRet = epoll_wait(mEpollfd, events, maxEvents, timeout);
+
+    // 以句柄注册, 转换为 Endpoint_t 地址; 端点已释放 (代数不符) 的过期事件直接丢弃
+    int count = 0;
+    for (int i = 0; i < nRet; ++i)
+    {
+        auto pe = Endpoint::fromHandle(events[i].data.u64);
+        if (pe)
+        {
+            events[count].events = events[i].events;
+            events[count].data.ptr = pe;
+            ++count;
+        }
+    }
+
+    return nRet < 0 ? nRet : count;
+}
+
+void EpollPoller::flush()
+{
+    for (auto &pending : mPending)
+    {
+        auto pe = Endpoint::fromHandle(pending.handle);
+        if (!pe || pe->pollState != POLLSTAT_DIRTY)
+        {
+            // 已释放或已移除
+            continue;
+        }
+        pe->pollState = POLLSTAT_CLEAN;
+        if (pe->pollEvents == pending.armed)
+        {
+            continue;
+        }
+
+        struct epoll_event event;
+        event.data.u64 = pending.handle;
+        event.events = pe->pollEvents;
+
+        countCtl();
+        if (epoll_ctl(mEpollfd, EPOLL_CTL_MOD, pe->soc, &event))
+        {
+            spdlog::error("[EpollPoller::flush] soc[{}] events[{:#x}] modify fail. {} - {}",
+                          pe->soc, (uint32_t)event.events, errno, strerror(errno));
+        }
+    }
+    mPending.clear();
+}
+
+void EpollPoller::discard(Endpoint_t *pe)
+{
+    if (pe->pollState != POLLSTAT_DIRTY)
+    {
+        return;
+    }
+
+    // 端点重新加入时, 不能沿用移除前记录的已注册掩码
+    pe->pollState = POLLSTAT_CLEAN;
+    auto handle = Endpoint::handle(pe);
+    for (size_t i = 0; i < mPending.size(); ++i)
+    {
+        if (mPending[i].handle == handle)
+        {
+            mPending[i] = mPending.back();
+            mPending.pop_back();
+            break;
+        }
+    }
+}
+
+} // namespace link
+} // namespace mapper
@@ -0,0 +1,112 @@
+/**
+ * @file poller.h
+ * @author Liu Yu (source@liuyu.com)
+ * @brief Event driver of services: epoll or io_uring backend.
+ * @version 1.0
+ * @date 2020-02-20
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef __MAPPER_LINK_POLLER_H__
+#define __MAPPER_LINK_POLLER_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <sys/epoll.h>
+#include "type.h"
+
+namespace mapper
+{
+namespace link
+{
+
+class Poller
+{
+public:
+    enum Backend_t
+    {
+        BACKEND_EPOLL = 0,
+        BACKEND_IO_URING
+    };
+
+protected:
+    Poller() : mpCtlCount(nullptr){};
+    Poller(const Poller &){};
+    Poller &operator=(const Poller &) { return *this; }
+
+public:
+    virtual ~Poller(){};
+
+    // 创建指定类型的 poller，io_uring 不可用时退回 epoll
+    // pCtlCount: 服务持有的计数器，累计提交给内核的事件注册操作数 (epoll_ctl 调用 / io_uring 请求)，
+    //            统计线程只读该计数器，不访问可能随 env 重建的 poller
+    static Poller *create(Backend_t backend, std::atomic<uint64_t> *pCtlCount);
+    static void release(Poller *pPoller);
+    static Backend_t parseBackend(const std::string &backend);
+
+    virtual Backend_t backend() = 0;
+    virtual bool add(Endpoint_t *pe, uint32_t events) = 0;
+    virtual bool modify(Endpoint_t *pe, uint32_t events) = 0;
+    virtual bool remove(Endpoint_t *pe) = 0;
+    // 返回值与 epoll_wait 一致，事件的 data.ptr 为对应的 Endpoint_t
+    virtual int wait(epoll_event *events, int maxEvents, int timeout) = 0;
+
+protected:
+    inline void countCtl() { mpCtlCount->fetch_add(1, std::memory_order_relaxed); }
+
+    std::atomic<uint64_t> *mpCtlCount;
+};
+
+/**
+ * epoll backend:
+ *
+ * - pe->pollEvents 为期望的事件掩码，modify() 只记录修改，于下一次 wait() 前统一提交，
+ *   同一轮中的多次修改合并为一次 epoll_ctl，最终与已注册掩码相同时不提交
+ * - 待提交的修改以句柄记录，其间 remove() 或释放的端点不再提交
+ */
+class EpollPoller : public Poller
+{
+protected:
+    // 借用 Endpoint_t::pollState 标记是否有待提交的修改
+    enum PollState_t
+    {
+        POLLSTAT_CLEAN = 0,
+        POLLSTAT_DIRTY
+    };
+
+    struct Pending_t
+    {
+        uint64_t handle;
+        uint32_t armed; // 已注册的事件掩码
+    };
+
+    EpollPoller() : mEpollfd(0){};
+
+public:
+    virtual ~EpollPoller();
+
+    static EpollPoller *create();
+
+    Backend_t backend() override { return BACKEND_EPOLL; }
+    bool add(Endpoint_t *pe, uint32_t events) override;
+    bool modify(Endpoint_t *pe, uint32_t events) override;
+    bool remove(Endpoint_t *pe) override;
+    int wait(epoll_event *events, int maxEvents, int timeout) override;
+
+protected:
+    // 提交待处理的修改
+    void flush();
+    // 端点不再提交待处理的修改
+    void discard(Endpoint_t *pe);
+
+    int mEpollfd;
+    std::vector<Pending_t> mPending;
+};
+
+} // namespace link
+} // namespace mapper
+
+#endif // __MAPPER_LINK_POLLER_H__
@@ -1,8 +1,13 @@
 #include "service.h"
+#include <limits.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sstream>
+#include <sys/sysinfo.h>
 #include <spdlog/spdlog.h>
+#include "endpoint.h"
 #include "tcpForwardService.h"
 #include "udpForwardService.h"
 #include "../utils/jsonUtils.h"
@@ -23,6 +28,12 @@ namespace link
 {
 
 const string Service::CONFIG_BASE_PATH = "/service";
+const string Service::SEETING_BACKEND = "epoll";
+const string Service::SEETING_BUFFER_POLICY = "firstFit";
+const string Service::SEETING_BUFFER_DEFRAG = "off";
+const string Service::SEETING_BUFFER_HUGEPAGE = "off";
+const string Service::SEETING_BUFFER_NUMA = "off";
+const string Service::SEETING_TCP_EDGE_TRIGGER = "off";
 
 bool Service::create(Document &cfg, list<Service *> &serviceList)
 {
@@ -160,40 +171,95 @@ void Service::release(list<Service *> &serviceList)
 
 void Service::loadSetting(rapidjson::Document &cfg, Setting_t &setting)
 {
-    // timeout
-    setting.connectTimeout =
-        JsonUtils::getAsUint32(cfg,
-                               CONFIG_BASE_PATH + "/setting/timeout/connect",
-                               SEETING_TIMEOUT_CONNECT);
-    setting.sessionTimeout =
-        JsonUtils::getAsUint32(cfg,
-                               CONFIG_BASE_PATH + "/setting/timeout/session",
-                               SEETING_TIMEOUT_SESSION);
-    setting.releaseTimeout =
-        JsonUtils::getAsUint32(cfg,
-                               CONFIG_BASE_PATH + "/setting/timeout/release",
-                               SEETING_TIMEOUT_RELEASE);
-    setting.udpTimeout =
-        JsonUtils::getAsUint32(cfg,
-                               CONFIG_BASE_PATH + "/setting/timeout/udp",
-                               SEETING_TIMEOUT_UDP);
+    // timeout: 以秒为单位配置, 可带小数 (如 0.5)
+    auto getTimeout = [&](const char *name, uint32_t defaultValue) -> uint32_t {
+        double timeout = JsonUtils::getAsDouble(cfg, CONFIG_BASE_PATH + "/setting/timeout/" + name, defaultValue);
+        timeout *= SEETING_TIMEOUT_UNIT;
+        return timeout <= 0 ? 0 : timeout < UINT32_MAX ? (uint32_t)timeout : UINT32_MAX;
+    };
+    setting.connectTimeout = getTimeout("connect", SEETING_TIMEOUT_CONNECT);
+    setting.sessionTimeout = getTimeout("session", SEETING_TIMEOUT_SESSION);
+    setting.releaseTimeout = getTimeout("release", SEETING_TIMEOUT_RELEASE);
+    setting.udpTimeout = getTimeout("udp", SEETING_TIMEOUT_UDP);
     // buffer
     setting.bufferSize =
         JsonUtils::getAsUint64(cfg,
                                CONFIG_BASE_PATH + "/setting/buffer/size",
                                SEETING_BUFFER_SIZE) *
         SEETING_BUFFER_SIZE_UNIT;
+    uint64_t memoryLimit = Utils::getMemoryLimit();
+    if (memoryLimit && setting.bufferSize > memoryLimit / SEETING_BUFFER_MEMORY_RATIO)
+    {
+        // tcp 及 udp 服务各自分配 size 大小的缓存, 并为其他内存预留空间
+        spdlog::warn("[Service::loadSetting] buffer size {} exceeds 1/{} of memory limit {}, reduced",
+                     setting.bufferSize, SEETING_BUFFER_MEMORY_RATIO, memoryLimit);
+        setting.bufferSize = memoryLimit / SEETING_BUFFER_MEMORY_RATIO;
+    }
     setting.bufferPerSessionLimit =
         JsonUtils::getAsUint64(cfg,
                                CONFIG_BASE_PATH + "/setting/buffer/perSessionLimit",
                                SEETING_BUFFER_PERSESSIONLIMIT) *
         SEETING_BUFFER_SIZE_UNIT;
+    setting.bufferPolicy =
+        buffer::DynamicBuffer::parsePolicy(JsonUtils::get(cfg,
+                                                          CONFIG_BASE_PATH + "/setting/buffer/policy",
+                                                          SEETING_BUFFER_POLICY));
+    setting.bufferDefrag =
+        JsonUtils::get(cfg,
+                       CONFIG_BASE_PATH + "/setting/buffer/defrag",
+                       SEETING_BUFFER_DEFRAG) == "on";
+    setting.bufferHugePage =
+        JsonUtils::get(cfg,
+                       CONFIG_BASE_PATH + "/setting/buffer/hugePage",
+                       SEETING_BUFFER_HUGEPAGE) == "on";
+    setting.bufferNuma =
+        JsonUtils::get(cfg,
+                       CONFIG_BASE_PATH + "/setting/buffer/numa",
+                       SEETING_BUFFER_NUMA) == "on";
+    setting.bufferTrim =
+        JsonUtils::getAsUint32(cfg,
+                               CONFIG_BASE_PATH + "/setting/buffer/trim",
+                               SEETING_BUFFER_TRIM);
+    // tcp
+    setting.tcpReactors =
+        JsonUtils::getAsUint32(cfg,
+                               CONFIG_BASE_PATH + "/setting/tcp/reactors",
+                               SEETING_TCP_REACTORS);
+    if (setting.tcpReactors == 0)
+    {
+        // 0: one reactor per available processor
+        setting.tcpReactors = get_nprocs();
+        setting.tcpReactors = setting.tcpReactors ? setting.tcpReactors : 1;
+    }
+    setting.tcpEdgeTrigger =
+        JsonUtils::get(cfg,
+                       CONFIG_BASE_PATH + "/setting/tcp/edgeTrigger",
+                       SEETING_TCP_EDGE_TRIGGER) == "on";
+    setting.tcpEventBudget =
+        (uint64_t)JsonUtils::getAsUint32(cfg,
+                                         CONFIG_BASE_PATH + "/setting/tcp/eventBudget",
+                                         SEETING_TCP_EVENT_BUDGET) *
+        SEETING_TCP_EVENT_BUDGET_UNIT;
+    // tunnel
+    setting.tunnelPrewarm =
+        JsonUtils::getAsUint32(cfg,
+                               CONFIG_BASE_PATH + "/setting/tunnel/prewarm",
+                               SEETING_TUNNEL_PREWARM);
+    // event driver
+    setting.backend =
+        Poller::parseBackend(JsonUtils::get(cfg,
+                                            CONFIG_BASE_PATH + "/setting/backend",
+                                            SEETING_BACKEND));
+    setting.eventBatch =
+        JsonUtils::getAsUint32(cfg,
+                               CONFIG_BASE_PATH + "/setting/eventBatch",
+                               SEETING_EVENT_BATCH);
+    setting.eventBatch || (setting.eventBatch = SEETING_EVENT_BATCH);
 }
 
-bool Service::epollAddEndpoint(int epollfd, Endpoint_t *pe, bool read, bool write, bool edgeTriger)
+bool Service::epollAddEndpoint(Poller *poller, Endpoint_t *pe, bool read, bool write, bool edgeTriger)
 {
     struct epoll_event event;
-    event.data.ptr = pe;
     event.events = EPOLLRDHUP |                // for peer close
                    (read ? EPOLLIN : 0) |      // enable read
                    (write ? EPOLLOUT : 0) |    // enable write
@@ -207,23 +273,22 @@ bool Service::epollAddEndpoint(int epollfd, Endpoint_t *pe, bool read, bool writ
                   event.events & EPOLLET ? "|EPOLLET" : "");
 #endif // ENABLE_DETAIL_LOGS
 
-    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, pe->soc, &event))
+    if (!poller->add(pe, event.events))
     {
         spdlog::error("[Service::epollAddEndpoint] events[EPOLLRDHUP{}{}{}]-soc[{}] join fail. Error {}: {}",
                       event.events & EPOLLIN ? "|EPOLLIN" : "",
                       event.events & EPOLLOUT ? "|EPOLLOUT" : "",
                       event.events & EPOLLET ? "|EPOLLET" : "",
-                      event.events, pe->soc, errno, strerror(errno));
+                      pe->soc, errno, strerror(errno));
         return false;
     }
 
     return true;
 }
 
-bool Service::epollResetEndpointMode(int epollfd, Endpoint_t *pe, bool read, bool write, bool edgeTriger)
+bool Service::epollResetEndpointMode(Poller *poller, Endpoint_t *pe, bool read, bool write, bool edgeTriger)
 {
     struct epoll_event event;
-    event.data.ptr = pe;
     event.events = EPOLLRDHUP |                // for peer close
                    (read ? EPOLLIN : 0) |      // enable read
                    (write ? EPOLLOUT : 0) |    // enable write
@@ -237,7 +302,7 @@ bool Service::epollResetEndpointMode(int epollfd, Endpoint_t *pe, bool read, boo
                   event.events & EPOLLET ? "|EPOLLET" : "");
 #endif // ENABLE_DETAIL_LOGS
 
-    if (epoll_ctl(epollfd, EPOLL_CTL_MOD, pe->soc, &event))
+    if (!poller->modify(pe, event.events))
     {
         spdlog::error("[Service::epollResetEndpointMode] events[EPOLLRDHUP{}{}{}]-soc[{}] reset fail. Error {}: {}",
                       event.events & EPOLLIN ? "|EPOLLIN" : "",
@@ -250,30 +315,90 @@ bool Service::epollResetEndpointMode(int epollfd, Endpoint_t *pe, bool read, boo
     return true;
 }
 
-bool Service::epollResetEndpointMode(int epollfd, Tunnel_t *pt, bool read, bool write, bool edgeTriger)
+bool Service::epollResetEndpointMode(Poller *poller, Tunnel_t *pt, bool read, bool write, bool edgeTriger)
 {
-    return epollResetEndpointMode(epollfd, pt->north, read, write, edgeTriger) &&
-           epollResetEndpointMode(epollfd, pt->south, read, write, edgeTriger);
+    return epollResetEndpointMode(poller, pt->north, read, write, edgeTriger) &&
+           epollResetEndpointMode(poller, pt->south, read, write, edgeTriger);
 }
 
-void Service::epollRemoveEndpoint(int epollfd, Endpoint_t *pe)
+void Service::epollRemoveEndpoint(Poller *poller, Endpoint_t *pe)
 {
 #ifdef ENABLE_DETAIL_LOGS
     spdlog::debug("[Service::epollRemoveEndpoint] soc[{}]", pe->soc);
 #endif // ENABLE_DETAIL_LOGS
 
     // remove from epoll driver
-    if (epoll_ctl(epollfd, EPOLL_CTL_DEL, pe->soc, nullptr))
+    if (!poller->remove(pe))
     {
         spdlog::error("[Service::epollRemoveEndpoint] remove endpoint[{}] from epoll fail. {} - {}",
                       Utils::dumpEndpoint(pe), errno, strerror(errno));
     }
 }
 
-void Service::epollRemoveTunnel(int epollfd, Tunnel_t *pt)
+void Service::epollRemoveTunnel(Poller *poller, Tunnel_t *pt)
+{
+    epollRemoveEndpoint(poller, pt->north);
+    epollRemoveEndpoint(poller, pt->south);
+}
+
+Endpoint_t *Service::createNotifier(Protocol_t protocol, Direction_t direction)
+{
+    auto pe = Endpoint::getEndpoint(protocol, direction, TYPE_NORMAL);
+    if (pe == nullptr)
+    {
+        return nullptr;
+    }
+    pe->soc = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (pe->soc < 0)
+    {
+        spdlog::error("[Service::createNotifier] create eventfd fail. {} - {}",
+                      errno, strerror(errno));
+        pe->soc = 0;
+        Endpoint::releaseEndpoint(pe);
+        return nullptr;
+    }
+    return pe;
+}
+
+void Service::releaseNotifier(Endpoint_t *&pNotifier)
+{
+    if (pNotifier)
+    {
+        pNotifier->soc && (::close(pNotifier->soc), (pNotifier->soc = 0));
+        Endpoint::releaseEndpoint(pNotifier);
+        pNotifier = nullptr;
+    }
+}
+
+void Service::notify(Endpoint_t *pNotifier)
+{
+    uint64_t count = 1;
+    if (write(pNotifier->soc, &count, sizeof(count)) < 0 && errno != EAGAIN)
+    {
+        spdlog::error("[Service::notify] write eventfd[{}] fail. {} - {}",
+                      pNotifier->soc, errno, strerror(errno));
+    }
+}
+
+void Service::clearNotify(Endpoint_t *pNotifier)
+{
+    uint64_t count;
+    read(pNotifier->soc, &count, sizeof(count));
+}
+
+int Service::waitTimeout(uint64_t curTime, uint64_t deadline)
+{
+    if (deadline == UINT64_MAX)
+    {
+        return -1;
+    }
+    return deadline > curTime ? (int)min(deadline - curTime, (uint64_t)INT_MAX) : 0;
+}
+
+uint64_t Service::housekeepingTime(uint64_t lastTime, bool busy, uint32_t trim)
 {
-    epollRemoveEndpoint(epollfd, pt->north);
-    epollRemoveEndpoint(epollfd, pt->south);
+    uint64_t interval = busy ? HOUSEKEEPING_INTERVAL : (uint64_t)trim * 1000;
+    return interval ? lastTime + interval : UINT64_MAX;
 }
 
 } // namespace link
@@ -16,6 +16,7 @@
 #include <memory>
 #include <string>
 #include <rapidjson/document.h>
+#include "poller.h"
 #include "type.h"
 #include "../buffer/dynamicBuffer.h"
 
@@ -31,15 +32,30 @@ protected:
     static const uint32_t SEETING_TIMEOUT_SESSION = 180;
     static const uint32_t SEETING_TIMEOUT_RELEASE = 3;
     static const uint32_t SEETING_TIMEOUT_UDP = 5;
+    static const uint32_t SEETING_TIMEOUT_UNIT = 1000; // second
     static const uint32_t SEETING_BUFFER_SIZE = 128;
     static const uint32_t SEETING_BUFFER_PERSESSIONLIMIT = 1;
     static const uint32_t SEETING_BUFFER_SIZE_UNIT = 1048576; // 1MB
+    static const std::string SEETING_BUFFER_POLICY;
+    static const std::string SEETING_BUFFER_DEFRAG;
+    static const std::string SEETING_BUFFER_HUGEPAGE;
+    static const std::string SEETING_BUFFER_NUMA;
+    static const uint32_t SEETING_BUFFER_TRIM = 0;
+    static const uint32_t SEETING_BUFFER_MEMORY_RATIO = 4; // buffer size is capped at 1/4 of the cgroup memory limit
+    static const uint32_t SEETING_TCP_REACTORS = 1;
+    static const std::string SEETING_TCP_EDGE_TRIGGER;
+    static const uint32_t SEETING_TCP_EVENT_BUDGET = 256; // KB
+    static const uint32_t SEETING_TCP_EVENT_BUDGET_UNIT = 1024;
+    static const uint32_t SEETING_TUNNEL_PREWARM = 0;
+    static const std::string SEETING_BACKEND;
+    static const uint32_t SEETING_EVENT_BATCH = 64;
+    static const uint64_t HOUSEKEEPING_INTERVAL = 1000; // ms, buffer statistic/trim/defrag of busy event loops
 
     static const std::string CONFIG_BASE_PATH;
 
     struct Setting_t
     {
-        // timeout
+        // timeout, unit: ms
         uint32_t connectTimeout;
         uint32_t sessionTimeout;
         uint32_t releaseTimeout;
@@ -47,6 +63,20 @@ protected:
         // buffer
         uint64_t bufferSize;
         uint64_t bufferPerSessionLimit;
+        buffer::DynamicBuffer::Policy_t bufferPolicy; // allocation policy of udp packet buffers
+        bool bufferDefrag;                            // compact fragmented tcp buffers in background
+        bool bufferHugePage;                          // back buffers with huge pages
+        bool bufferNuma;                              // place buffers on the numa node of their event loop thread
+        uint32_t bufferTrim;                          // seconds, return free buffer memory idle for it, 0: never
+        // tcp
+        uint32_t tcpReactors;    // event loop threads of tcp forward service
+        bool tcpEdgeTrigger;     // register tunnel sockets with EPOLLET
+        uint64_t tcpEventBudget; // bytes received/sent by a tunnel socket per event, 0: no limit
+        // tunnel
+        uint32_t tunnelPrewarm; // tunnel objects allocated by each event loop thread at startup
+        // event driver
+        Poller::Backend_t backend;
+        uint32_t eventBatch; // max events returned by one wait of an event loop
     };
 
     Service(std::string &&name) { mName = name; };
@@ -68,11 +98,22 @@ public:
 protected:
     static void loadSetting(rapidjson::Document &cfg, Setting_t &setting);
 
-    static bool epollAddEndpoint(int epollfd, Endpoint_t *pe, bool read, bool write, bool edgeTriger);
-    static bool epollResetEndpointMode(int epollfd, Endpoint_t *pe, bool read, bool write, bool edgeTriger);
-    static bool epollResetEndpointMode(int epollfd, Tunnel_t *pt, bool read, bool write, bool edgeTriger);
-    static void epollRemoveEndpoint(int epollfd, Endpoint_t *pe);
-    static void epollRemoveTunnel(int epollfd, Tunnel_t *pt);
+    static bool epollAddEndpoint(Poller *poller, Endpoint_t *pe, bool read, bool write, bool edgeTriger);
+    static bool epollResetEndpointMode(Poller *poller, Endpoint_t *pe, bool read, bool write, bool edgeTriger);
+    static bool epollResetEndpointMode(Poller *poller, Tunnel_t *pt, bool read, bool write, bool edgeTriger);
+    static void epollRemoveEndpoint(Poller *poller, Endpoint_t *pe);
+    static void epollRemoveTunnel(Poller *poller, Tunnel_t *pt);
+
+    // eventfd, added into a poller to wake its event loop up (stop, cross-thread notification)
+    static Endpoint_t *createNotifier(Protocol_t protocol, Direction_t direction);
+    static void releaseNotifier(Endpoint_t *&pNotifier);
+    static void notify(Endpoint_t *pNotifier);
+    static void clearNotify(Endpoint_t *pNotifier);
+
+    // 事件循环无定时唤醒: 等待至下一个需要处理的时间 (单调时钟, ms), UINT64_MAX 表示无限等待
+    static int waitTimeout(uint64_t curTime, uint64_t deadline);
+    // 上次整理后有事件时, 每 HOUSEKEEPING_INTERVAL 整理一次缓存; 空闲时只为归还缓存按 trim 周期唤醒
+    static uint64_t housekeepingTime(uint64_t lastTime, bool busy, uint32_t trim);
 
     std::string mName;
 };
@@ -1,7 +1,12 @@
 #include "tcpForwardService.h"
 #include <execinfo.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <time.h>
+#include <unistd.h>
 #include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <sstream>
 #include <spdlog/spdlog.h>
 #include "endpoint.h"
@@ -21,8 +26,13 @@ namespace link
 {
 
 const uint32_t TcpForwardService::EPOLL_THREAD_RETRY_INTERVAL = 7;
-const uint32_t TcpForwardService::EPOLL_MAX_EVENTS = 8;
-const uint32_t TcpForwardService::INTERVAL_EPOLL_WAIT_TIME = 50;
+const uint32_t TcpForwardService::SEND_MAX_IOV = IOV_MAX;
+const uint64_t TcpForwardService::DEFRAG_STEP_SIZE = 4 * 1024 * 1024;
+const uint64_t TcpForwardService::SMALL_READ_RESERVE = 1024;
+const int64_t TcpForwardService::RING_MAX_CAPACITY = 256 * 1024 * 1024;
+const uint32_t TcpForwardService::RING_POOL_LIMIT = 64;
+const uint64_t TcpForwardService::URING_BUF_SIZE = 64 * 1024;
+const uint32_t TcpForwardService::URING_BUF_COUNT = 1024;
 
 /**
  * tunnel state machine:
@@ -47,14 +57,33 @@ const bool TcpForwardService::StateMaine[TUNNEL_STATE_COUNT][TUNNEL_STATE_COUNT]
 };
 
 TcpForwardService::TcpForwardService()
+    : TcpForwardService(0)
+{
+}
+
+TcpForwardService::TcpForwardService(uint32_t reactorId)
     : Service("tcpFwd"),
-      mEpollfd(0),
+      mReactorId(reactorId),
+      mpPoller(nullptr),
+      mpUring(nullptr),
+      mpNotifier(nullptr),
+      mIoBudget(0),
+      mBusy(false),
       mStopFlag(false),
       mpDynamicBuffer(nullptr),
+      mpParkedHead(nullptr),
+      mpParkedTail(nullptr),
+      mFreeRecvBufs(0),
+      mReservedLimit(0),
+      mReservedUsed(0),
+      mLastScanTime(0),
+      mLastStatisticTime(time(nullptr)),
       mUp(0),
       mDown(0),
       mTotalUp(0),
-      mTotalDown(0)
+      mTotalDown(0),
+      mCtlCount(0),
+      mLastCtlCount(0)
 {
 }
 
@@ -79,14 +108,23 @@ TcpForwardService::~TcpForwardService()
     }
     mTunnelList.clear();
 
-    // release buffer
+    // release other reactors
+    for (auto pReactor : mReactorList)
+    {
+        pReactor->close();
+        delete pReactor;
+    }
+    mReactorList.clear();
+
+    // release buffer and notifier
     mpDynamicBuffer && (DynamicBuffer::releaseDynamicBuffer(mpDynamicBuffer), mpDynamicBuffer = nullptr);
+    releaseNotifier(mpNotifier);
 }
 
 bool TcpForwardService::init(list<shared_ptr<Forward>> &forwardList,
                              Setting_t &setting)
 {
-    spdlog::debug("[TcpForwardService::init] init tcp forward service");
+    spdlog::debug("[TcpForwardService::init] init tcp forward service, reactor[{}]", mReactorId);
 
     // check existed thread
     if (mMainRoutineThread.joinable())
@@ -99,15 +137,79 @@ bool TcpForwardService::init(list<shared_ptr<Forward>> &forwardList,
     mSetting = setting;
     mForwardList.swap(forwardList);
 
+    // 每个 reactor 各自拥有一份服务配置，缓冲区按 reactor 数量均分
+    uint32_t reactors = setting.tcpReactors ? setting.tcpReactors : 1;
+    mSetting.tcpReactors = 1;
+    mSetting.bufferSize = setting.bufferSize / reactors;
+
     // create buffer
     spdlog::trace("[TcpForwardService::init] create buffer");
-    mpDynamicBuffer = buffer::DynamicBuffer::allocDynamicBuffer(setting.bufferSize);
+    mpDynamicBuffer = buffer::DynamicBuffer::allocDynamicBuffer(mSetting.bufferSize,
+                                                                DynamicBuffer::POLICY_FIRST_FIT,
+                                                                mSetting.bufferHugePage);
     if (!mpDynamicBuffer)
     {
         spdlog::error("[TcpForwardService::init] alloc buffer fail");
         return false;
     }
 
+    // create notifier and events of one wait
+    mEvents.resize(mSetting.eventBatch);
+    if (!mpNotifier && !(mpNotifier = createNotifier(PROTOCOL_TCP, TO_NORTH)))
+    {
+        spdlog::error("[TcpForwardService::init] create notifier fail");
+        return false;
+    }
+
+    // per-forward buffer budgets, reserved from the buffer of each reactor
+    // 重新 init 时按当前转发配置重建，避免沿用旧的预算与预留总量
+    mBudgets.clear();
+    mReservedLimit = 0;
+    mReservedUsed = 0;
+    for (auto &forward : mForwardList)
+    {
+        ServiceSetting_t serviceSetting;
+        if (loadServiceSetting(*forward, serviceSetting) &&
+            mBudgets.insert({forward->interface + ":" + forward->service, {serviceSetting.budget, 0, 0}}).second)
+        {
+            mReservedLimit += serviceSetting.budget;
+        }
+    }
+    mBudgetTable.assign(1, nullptr);
+    for (auto &it : mBudgets)
+    {
+        it.second.id = mBudgetTable.size();
+        mBudgetTable.push_back(&it.second);
+    }
+    if (mReservedLimit >= (int64_t)mSetting.bufferSize)
+    {
+        spdlog::warn("[TcpForwardService::init] budgets of forwards {} exceed the buffer of a reactor {}",
+                     mReservedLimit, mSetting.bufferSize);
+    }
+
+    // create other reactors
+    for (uint32_t i = 1; i < reactors; ++i)
+    {
+        spdlog::trace("[TcpForwardService::init] create reactor[{}]", i);
+        auto pReactor = new TcpForwardService(i);
+        auto forwards = mForwardList;
+        if (!pReactor->init(forwards, mSetting))
+        {
+            spdlog::error("[TcpForwardService::init] init reactor[{}] fail", i);
+            delete pReactor;
+
+            // 停止并释放已启动的 reactor
+            for (auto pStarted : mReactorList)
+            {
+                pStarted->close();
+                delete pStarted;
+            }
+            mReactorList.clear();
+            return false;
+        }
+        mReactorList.push_back(pReactor);
+    }
+
     // start thread
     spdlog::trace("[TcpForwardService::init] start thread");
     mMainRoutineThread = thread(&TcpForwardService::epollThread, this);
@@ -118,6 +220,10 @@ bool TcpForwardService::init(list<shared_ptr<Forward>> &forwardList,
 void TcpForwardService::join()
 {
     mMainRoutineThread.joinable() && (mMainRoutineThread.join(), true);
+    for (auto pReactor : mReactorList)
+    {
+        pReactor->join();
+    }
 }
 
 void TcpForwardService::stop()
@@ -125,6 +231,11 @@ void TcpForwardService::stop()
     // set stop flag
     spdlog::trace("[TcpForwardService::stop] set stop flag");
     mStopFlag = true;
+    mpNotifier && (notify(mpNotifier), true);
+    for (auto pReactor : mReactorList)
+    {
+        pReactor->stop();
+    }
 }
 
 void TcpForwardService::close()
@@ -133,9 +244,15 @@ void TcpForwardService::close()
 
     // stop thread
     spdlog::trace("[TcpForwardService::close] stop thread");
-    mStopFlag = true;
+    stop();
     join();
 
+    // close other reactors
+    for (auto pReactor : mReactorList)
+    {
+        pReactor->close();
+    }
+
     // release buffer
     spdlog::trace("[TcpForwardService::close] release buffer");
     if (mpDynamicBuffer)
@@ -143,19 +260,62 @@ void TcpForwardService::close()
         DynamicBuffer::releaseDynamicBuffer(mpDynamicBuffer);
         mpDynamicBuffer = nullptr;
     }
+    releaseNotifier(mpNotifier);
 }
 
 string TcpForwardService::getStatistic(time_t curTime)
 {
-    static time_t lastTime = 0;
-    time_t deltaTime = curTime - lastTime;
-    lastTime = curTime;
+    time_t deltaTime = curTime - mLastStatisticTime;
+    mLastStatisticTime = curTime;
     deltaTime = deltaTime ? deltaTime : 1;
 
+    // 汇总所有 reactor 的统计数据
+    float up = mUp;
+    float down = mDown;
+    float totalUp = mTotalUp;
+    float totalDown = mTotalDown;
+    uint64_t ctlCount = mCtlCount;
+    auto bufferStatistic = mpDynamicBuffer ? mpDynamicBuffer->getStatistic() : DynamicBuffer::Statistic_t{};
+    for (auto pReactor : mReactorList)
+    {
+        up += pReactor->mUp;
+        down += pReactor->mDown;
+        totalUp += pReactor->mTotalUp;
+        totalDown += pReactor->mTotalDown;
+        ctlCount += pReactor->mCtlCount;
+
+        pReactor->mpDynamicBuffer && (DynamicBuffer::accumulate(bufferStatistic, pReactor->mpDynamicBuffer->getStatistic()), true);
+    }
+
+    // 各 forward 的缓冲区占用及预算
+    map<string, pair<int64_t, int64_t>> budgets;
+    auto accumulateBudgets = [&budgets](TcpForwardService *pReactor) {
+        for (auto &it : pReactor->mBudgets)
+        {
+            budgets[it.first].first += it.second.used;
+            budgets[it.first].second += it.second.limit;
+        }
+    };
+    accumulateBudgets(this);
+    for (auto pReactor : mReactorList)
+    {
+        accumulateBudgets(pReactor);
+    }
+
     stringstream ss;
 
-    ss << "u/d:" << Utils::toHumanStr(mUp / deltaTime) << "ps/" << Utils::toHumanStr(mDown / deltaTime)
-       << "ps,tu/td:" << Utils::toHumanStr(mTotalUp) << "/" << Utils::toHumanStr(mTotalDown);
+    ss << "u/d:" << Utils::toHumanStr(up / deltaTime) << "ps/" << Utils::toHumanStr(down / deltaTime)
+       << "ps,tu/td:" << Utils::toHumanStr(totalUp) << "/" << Utils::toHumanStr(totalDown)
+       << ",ctl:" << (ctlCount - mLastCtlCount) / deltaTime << "ps"
+       << "," << DynamicBuffer::dumpStatistic(bufferStatistic)
+       << ",fwd:[";
+    for (auto it = budgets.begin(); it != budgets.end(); ++it)
+    {
+        ss << (it == budgets.begin() ? "" : ",") << it->first << " " << Utils::toHumanStr(it->second.first);
+        it->second.second && (ss << "/" << Utils::toHumanStr(it->second.second), true);
+    }
+    ss << "]";
+    mLastCtlCount = ctlCount;
 
     return ss.str();
 }
@@ -164,9 +324,14 @@ void TcpForwardService::resetStatistic()
 {
     mUp = 0;
     mDown = 0;
+    mpDynamicBuffer && (mpDynamicBuffer->resetStatistic(), true);
+    for (auto pReactor : mReactorList)
+    {
+        pReactor->resetStatistic();
+    }
 }
 
-void TcpForwardService::postProcess(time_t curTime)
+void TcpForwardService::postProcess()
 {
     if (!mPostProcessList.empty())
     {
@@ -179,14 +344,14 @@ void TcpForwardService::postProcess(time_t curTime)
                 spdlog::debug("[TcpForwardService::postProcess] remove connecting tunnel[{}:{}]",
                               pt->south->soc, pt->north->soc);
                 setStatus(pt, TUNSTAT_BROKEN);
-                switchTimer(mConnectTimer, mReleaseTimer, curTime, pt);
+                addToTimer(mSetting.releaseTimeout, pt);
                 break;
             case TUNSTAT_ESTABLISHED:
                 spdlog::debug("[TcpForwardService::postProcess] remove established tunnel[{}:{}]",
                               pt->south->soc, pt->north->soc);
                 setStatus(pt, TUNSTAT_BROKEN);
-                // switch timeout container
-                switchTimer(mSessionTimer, mReleaseTimer, curTime, pt);
+                // switch timeout
+                addToTimer(mSetting.releaseTimeout, pt);
                 break;
             case TUNSTAT_INITIALIZED:
             case TUNSTAT_BROKEN:
@@ -205,40 +370,43 @@ void TcpForwardService::postProcess(time_t curTime)
     }
 }
 
-void TcpForwardService::scanTimeout(time_t curTime)
+void TcpForwardService::scanTimeout()
 {
-    // check connecting/established tunnel timeout
-    list<TimerList::Entity_t *> timeoutList;
-    auto f = [&](TimerList &timer, time_t timeoutTime) {
-        timeoutList.clear();
-        timer.getTimeoutList(timeoutTime, timeoutList);
-        for (auto entity : timeoutList)
+    mTimerWheel.expire(Clock::ms(), [this](TimingWheel::Entity_t *entity) {
+        auto pt = (Tunnel_t *)entity->container;
+        if (pt->stat == TUNSTAT_BROKEN)
+        {
+            // check broken tunnel timeout
+            spdlog::debug("[TcpForwardService::scanTimeout] broken tunnel[{}:{}] timeout",
+                          pt->south->soc, pt->north->soc);
+            setStatus(pt, TUNSTAT_CLOSED);
+            closeTunnel(pt);
+        }
+        else
         {
-            auto pt = (Tunnel_t *)entity->container;
+            // connecting/established tunnel timeout
             spdlog::debug("[TcpForwardService::scanTimeout] tunnel[{}:{}] timeout",
                           pt->south->soc, pt->north->soc);
+            // 关闭前仍留在时间轮中 (defragment 经时间轮遍历全部 tunnel), 由 postProcess 切换超时时长
+            addToTimer(entity->timeout, pt);
             addToCloseList(pt);
         }
-    };
-    f(mConnectTimer, curTime - mSetting.connectTimeout);
-    f(mSessionTimer, curTime - mSetting.sessionTimeout);
-
-    // check broken tunnel timeout
-    timeoutList.clear();
-    mReleaseTimer.getTimeoutList(curTime - mSetting.releaseTimeout, timeoutList);
-    for (auto entity : timeoutList)
-    {
-        auto pt = (Tunnel_t *)entity->container;
-        spdlog::debug("[TcpForwardService::scanTimeout] broken tunnel[{}:{}] timeout",
-                      pt->south->soc, pt->north->soc);
-        setStatus(pt, TUNSTAT_CLOSED);
-        closeTunnel(pt);
-    }
+    });
 }
 
 void TcpForwardService::epollThread()
 {
-    spdlog::debug("[TcpForwardService::epollThread] tcp forward service thread start");
+    spdlog::debug("[TcpForwardService::epollThread] tcp forward service thread start, reactor[{}]", mReactorId);
+
+    // 缓存只在本线程中分配/释放, 无需加锁
+    mpDynamicBuffer->bindOwner(mSetting.bufferNuma);
+    Clock::update();
+
+    // 预先分配本线程对象池中的 tunnel 及其南北向 endpoint
+    if (!Tunnel::prewarm(mSetting.tunnelPrewarm) || !Endpoint::prewarm(mSetting.tunnelPrewarm * 2))
+    {
+        spdlog::warn("[TcpForwardService::epollThread] prewarm {} tunnels fail", mSetting.tunnelPrewarm);
+    }
 
     while (!mStopFlag)
     {
@@ -258,7 +426,7 @@ void TcpForwardService::epollThread()
         {
             while (!mStopFlag)
             {
-                if (!doEpoll(mEpollfd))
+                if (!doEpoll())
                 {
                     spdlog::error("[TcpForwardService::epollThread] do epoll fail.");
                     break;
@@ -297,17 +465,39 @@ void TcpForwardService::epollThread()
         }
     }
 
-    spdlog::debug("[TcpForwardService::epollThread] tcp forward service thread stop");
+    spdlog::debug("[TcpForwardService::epollThread] tcp forward service thread stop, reactor[{}]", mReactorId);
 }
 
 bool TcpForwardService::initEnv()
 {
-    // init epoll fd
-    spdlog::trace("[TcpForwardService::initEnv] init epoll fd");
-    if ((mEpollfd = epoll_create1(0)) < 0)
+    // init poller
+    spdlog::trace("[TcpForwardService::initEnv] init poller");
+    if ((mpPoller = Poller::create(mSetting.backend, &mCtlCount)) == nullptr)
     {
-        spdlog::error("[TcpForwardService::initEnv] Failed to create epolls. {} - {}",
-                      errno, strerror(errno));
+        spdlog::error("[TcpForwardService::initEnv] Failed to create poller.");
+        return false;
+    }
+    // io_uring 后端以完成模式收发 buffer 模式的 tunnel, 需要缓冲区环 (linux 5.19+), 否则退回 epoll
+    mpUring = mpPoller->backend() == Poller::BACKEND_IO_URING ? (UringPoller *)mpPoller : nullptr;
+    if (mpUring && !initRecvBufs())
+    {
+        spdlog::warn("[TcpForwardService::initEnv] provided buffer ring is not available, fall back to epoll");
+        releaseRecvBufs();
+        Poller::release(mpPoller);
+        mpUring = nullptr;
+        if ((mpPoller = Poller::create(Poller::BACKEND_EPOLL, &mCtlCount)) == nullptr)
+        {
+            spdlog::error("[TcpForwardService::initEnv] Failed to create poller.");
+            return false;
+        }
+    }
+    // io_uring 的 poll 请求触发后即重新注册, 相当于水平触发
+    mSetting.tcpEdgeTrigger = mSetting.tcpEdgeTrigger && mpPoller->backend() == Poller::BACKEND_EPOLL;
+
+    // add notifier into poller
+    if (!epollAddEndpoint(mpPoller, mpNotifier, true, false, false))
+    {
+        spdlog::error("[TcpForwardService::initEnv] add notifier into poller fail.");
         return false;
     }
 
@@ -332,6 +522,17 @@ bool TcpForwardService::initEnv()
         {
             // 新服务
 
+            // load service setting
+            ServiceSetting_t serviceSetting;
+            if (!loadServiceSetting(*forward, serviceSetting))
+            {
+                spdlog::error("[TcpForwardService::initEnv] load setting of forward{} fail.", forward->toStr());
+                return false;
+            }
+            auto itBudget = mBudgets.find(forward->interface + ":" + forward->service);
+            assert(itBudget != mBudgets.end());
+            serviceSetting.budgetId = itBudget->second.id;
+
             // create service endpoint
             spdlog::trace("[TcpForwardService::initEnv] create service endpoint");
             pse = Endpoint::getEndpoint(PROTOCOL_TCP, TO_SOUTH, TYPE_SERVICE);
@@ -346,8 +547,10 @@ bool TcpForwardService::initEnv()
             pse->soc = Utils::createServiceSoc(PROTOCOL_TCP, &sai, sizeof(sockaddr_in));
             if (pse->soc > 0)
             {
-                pse->conn.localAddr = sai;
+                Endpoint::cold(pse)->conn.localAddr = sai;
                 mAddr2ServiceEndpoint[sai] = pse;
+                mServiceSettingList.push_back(serviceSetting);
+                pse->container = &mServiceSettingList.back();
             }
             else
             {
@@ -357,16 +560,16 @@ bool TcpForwardService::initEnv()
                 return false;
             }
 
-            // add service endpoint into epoll driver
+            // add service endpoint into epoll driver, or accept clients by io_uring multishot accept
             spdlog::trace("[TcpForwardService::initEnv] add service endpoint into epoll driver");
-            if (!epollAddEndpoint(mEpollfd, pse, true, false, false))
+            if (mpUring ? !mpUring->accept(pse) : !epollAddEndpoint(mpPoller, pse, true, false, false))
             {
                 spdlog::error("[TcpForwardService::init] add service endpoint into epoll driver fail.");
                 return false;
             }
 
             spdlog::trace("[TcpForwardService::initEnv] create tcp forward service: {}",
-                          Utils::dumpSockAddr(pse->conn.localAddr));
+                          Utils::dumpSockAddr(Endpoint::cold(pse)->conn.localAddr));
         }
         else
         {
@@ -379,7 +582,7 @@ bool TcpForwardService::initEnv()
         {
             spdlog::info("[TcpForwardService::initEnv] service[{}] add target: {} -> {}:{}",
                          pse->soc,
-                         Utils::dumpSockAddr(pse->conn.localAddr),
+                         Utils::dumpSockAddr(Endpoint::cold(pse)->conn.localAddr),
                          forward->targetHost, forward->targetService);
         }
         else
@@ -402,50 +605,84 @@ void TcpForwardService::closeEnv()
         for (auto it : mAddr2ServiceEndpoint)
         {
             spdlog::trace("[TcpForwardService::closeEnv] close tcp forward service: {}",
-                          Utils::dumpSockAddr(it.second->conn.localAddr));
+                          Utils::dumpSockAddr(Endpoint::cold(it.second)->conn.localAddr));
+
+            if (it.second->soc)
+            {
+                // remove service socket from poller
+                epollRemoveEndpoint(mpPoller, it.second);
 
-            // close socket
-            it.second->soc && (::close(it.second->soc), it.second->soc = 0);
+                // close socket
+                ::close(it.second->soc);
+                it.second->soc = 0;
+            }
             // release endpoint_t object
             Endpoint::releaseEndpoint(it.second);
         }
         mAddr2ServiceEndpoint.clear();
     }
+    mServiceSettingList.clear();
+    mpParkedHead = mpParkedTail = nullptr;
+    for (auto handle : mReadyList)
+    {
+        auto pe = Endpoint::fromHandle(handle);
+        pe && (pe->readyEvents = 0);
+    }
+    mReadyList.clear();
+
+    // release idle ring buffers
+    releaseRingPool();
 
     // clean target manager
     mTargetManager.clear();
 
-    // close epoll fd
-    spdlog::trace("[TcpForwardService::closeEnv] close epoll fd");
-    mEpollfd && (::close(mEpollfd), mEpollfd = 0);
-}
+    // remove notifier from poller
+    mpPoller && (epollRemoveEndpoint(mpPoller, mpNotifier), true);
 
-bool TcpForwardService::doEpoll(int epollfd)
-{
-    static time_t lastScanTime = 0;
+    // release poller
+    spdlog::trace("[TcpForwardService::closeEnv] release poller");
+    mpPoller && (Poller::release(mpPoller), mpPoller = nullptr);
+    mpUring = nullptr;
 
-    time_t curTime;
-    struct epoll_event ee[EPOLL_MAX_EVENTS];
+    // ring 关闭时其请求均被撤销, 缓冲区环中的缓冲区归还 DynamicBuffer
+    releaseRecvBufs();
+    mStarvedList.clear();
+}
 
-    int nRet = epoll_wait(epollfd, ee, EPOLL_MAX_EVENTS, INTERVAL_EPOLL_WAIT_TIME);
-    curTime = time(nullptr);
+bool TcpForwardService::doEpoll()
+{
+    auto ee = mEvents.data();
+
+    // wait until the next timeout or housekeeping, or until woken up by the notifier;
+    // do not wait while there are tunnels to post process or endpoints ready to go on
+    uint64_t deadline = mPostProcessList.empty() && mReadyList.empty()
+                            ? min(mTimerWheel.nextExpire(),
+                                  housekeepingTime(mLastScanTime, mBusy, mSetting.bufferTrim))
+                            : Clock::ms();
+    int nRet = mpPoller->wait(ee, mEvents.size(), waitTimeout(Clock::ms(), deadline));
+    uint64_t curTime = Clock::update();
     if (nRet > 0)
     {
+        mBusy = true;
         for (int i = 0; i < nRet; ++i)
         {
             link::Endpoint_t *pe = (link::Endpoint_t *)ee[i].data.ptr;
 
-            if (pe->type == TYPE_SERVICE)
+            if (pe == mpNotifier)
+            {
+                clearNotify(pe);
+            }
+            else if (pe->type == TYPE_SERVICE)
             {
                 if (ee[i].events & EPOLLIN)
                 {
                     // accept client
-                    acceptClient(curTime, pe);
+                    acceptClient(pe);
                 }
             }
             else
             {
-                doTunnelSoc(curTime, pe, ee[i].events);
+                doTunnelSoc(pe, ee[i].events);
             }
         }
     }
@@ -459,22 +696,47 @@ bool TcpForwardService::doEpoll(int epollfd)
         }
     }
 
-    // post process
-    postProcess(curTime);
+    // completions of io_uring requests
+    if (mpUring && !mpUring->completions().empty())
+    {
+        mBusy = true;
+        for (auto &c : mpUring->completions())
+        {
+            doCompletion(c);
+        }
+    }
+
+    // go on with endpoints whose budget ran out, or resumed, under edge trigger
+    processReadyList();
 
     // scan timeout
-    if (lastScanTime < curTime)
+    scanTimeout();
+
+    // post process
+    postProcess();
+
+    // resume readers parked by buffer exhaustion
+    resumeParkedReaders();
+    mpUring && (resumeStarvedReaders(), true);
+
+    if (curTime >= mLastScanTime + HOUSEKEEPING_INTERVAL)
     {
-        scanTimeout(curTime);
-        lastScanTime = curTime;
+        mLastScanTime = curTime;
+        mBusy = false;
+
+        // buffer fragmentation
+        mpDynamicBuffer->updateFragmentation();
+        mSetting.bufferTrim && (mpDynamicBuffer->trim(Clock::seconds(), mSetting.bufferTrim), true);
+        (mSetting.bufferDefrag && mpDynamicBuffer->fragmented()) && (defragment(), true);
     }
 
     return true;
 }
 
-void TcpForwardService::doTunnelSoc(time_t curTime, Endpoint_t *pe, uint32_t events)
+void TcpForwardService::doTunnelSoc(Endpoint_t *pe, uint32_t events)
 {
     auto pt = (Tunnel_t *)pe->container;
+    int64_t budget = mSetting.tcpEventBudget ? mSetting.tcpEventBudget : INT64_MAX;
 
     if (!pe->valid)
     {
@@ -483,11 +745,42 @@ void TcpForwardService::doTunnelSoc(time_t curTime, Endpoint_t *pe, uint32_t eve
         return;
     }
 
-    // Write
-    (events & EPOLLOUT) && (onWrite(curTime, events, pe), true);
+    // Write, 收发各自使用一份预算
+    mIoBudget = budget;
+    (events & EPOLLOUT) && (onWrite(events, pe), true);
 
     // Read
-    (events & EPOLLIN && !pe->peer->bufferFull) && (onRead(curTime, events, pe), true);
+    mIoBudget = budget;
+    (events & EPOLLIN && !pe->peer->bufferFull) && (onRead(events, pe), true);
+}
+
+void TcpForwardService::setReady(Endpoint_t *pe, uint32_t events)
+{
+    if (!mSetting.tcpEdgeTrigger)
+    {
+        return;
+    }
+
+    // 已在就绪链表中时只合并事件
+    pe->readyEvents || (mReadyList.push_back(Endpoint::handle(pe)), true);
+    pe->readyEvents |= events;
+}
+
+void TcpForwardService::processReadyList()
+{
+    // 处理过程中加入的端点留待下一轮
+    size_t count = mReadyList.size();
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto pe = Endpoint::fromHandle(mReadyList[i]);
+        if (pe)
+        {
+            uint32_t events = pe->readyEvents;
+            pe->readyEvents = 0;
+            doTunnelSoc(pe, events);
+        }
+    }
+    mReadyList.erase(mReadyList.begin(), mReadyList.begin() + count);
 }
 
 void TcpForwardService::setStatus(Tunnel_t *pt, TunnelState_t stat)
@@ -546,20 +839,20 @@ Tunnel_t *TcpForwardService::getTunnel()
     // link resources
     pt->north = north;
     pt->south = south;
-    pt->service = this;
+    Tunnel::cold(pt)->service = this;
     north->peer = south;
-    north->service = this;
     north->container = pt;
+    Endpoint::cold(north)->service = this;
     south->peer = north;
-    south->service = this;
     south->container = pt;
+    Endpoint::cold(south)->service = this;
 
     setStatus(pt, TUNSTAT_INITIALIZED);
 
     return pt;
 }
 
-void TcpForwardService::acceptClient(time_t curTime, Endpoint_t *pse)
+void TcpForwardService::acceptClient(Endpoint_t *pse, int soc)
 {
     // alloc resources
     Tunnel_t *pt = getTunnel();
@@ -568,7 +861,7 @@ void TcpForwardService::acceptClient(time_t curTime, Endpoint_t *pse)
         spdlog::error("[TcpForwardService::acceptClient] out of tunnel");
 
         // reject new clients by accept and close it
-        int soc = accept(pse->soc, nullptr, nullptr);
+        soc = soc < 0 ? accept(pse->soc, nullptr, nullptr) : soc;
         (soc > 0) && ::close(soc);
 
         return;
@@ -576,16 +869,22 @@ void TcpForwardService::acceptClient(time_t curTime, Endpoint_t *pse)
 
     // set status
     setStatus(pt, TUNSTAT_CONNECT);
+    auto pss = (ServiceSetting_t *)pse->container;
+    // io_uring 后端下 buffer 模式的 tunnel 以完成模式收发, splice/ring 模式仍以 poll 请求驱动
+    pt->mode = (mpUring && pss->mode == TUNMODE_BUFFER) ? TUNMODE_URING : pss->mode;
+    pt->budget = pss->budgetId;
+    pt->north->highWatermark = pt->south->highWatermark = pss->highWatermark;
+    pt->north->lowWatermark = pt->south->lowWatermark = pss->lowWatermark;
 
     // add into timeout timer
-    addToTimer(mConnectTimer, curTime, pt);
+    addToTimer(mSetting.connectTimeout, pt);
 
     if (![&]() -> bool {
             // accept client
-            pt->south->conn.remoteAddrLen = sizeof(pt->south->conn.remoteAddr);
-            pt->south->soc = accept(pse->soc,
-                                    (sockaddr *)&pt->south->conn.remoteAddr,
-                                    &pt->south->conn.remoteAddrLen);
+            auto &conn = Endpoint::cold(pt->south)->conn;
+            conn.remoteAddrLen = sizeof(conn.remoteAddr);
+            pt->south->soc = soc < 0 ? accept(pse->soc, (sockaddr *)&conn.remoteAddr, &conn.remoteAddrLen)
+                                     : (getpeername(soc, (sockaddr *)&conn.remoteAddr, &conn.remoteAddrLen), soc);
             if (pt->south->soc == -1)
             {
                 if (errno == EAGAIN)
@@ -599,7 +898,7 @@ void TcpForwardService::acceptClient(time_t curTime, Endpoint_t *pse)
                 return false;
             }
             spdlog::debug("[TcpForwardService::acceptClient] accept client[{}]: {}",
-                          pt->south->soc, Utils::dumpSockAddr(pt->south->conn.remoteAddr));
+                          pt->south->soc, Utils::dumpSockAddr(conn.remoteAddr));
 
             // set client socket to non-block mode
             if (!Utils::setSocAttr(pt->south->soc, true, false))
@@ -616,16 +915,33 @@ void TcpForwardService::acceptClient(time_t curTime, Endpoint_t *pse)
                 return false;
             }
 
+            // create pipes for splice mode
+            if (pt->mode == TUNMODE_SPLICE &&
+                (!createPipe(pt->north) || !createPipe(pt->south)))
+            {
+                spdlog::error("[TcpForwardService::acceptClient] create pipes fail");
+                return false;
+            }
+
+            // create ring buffers for ring mode
+            if (pt->mode == TUNMODE_RING &&
+                (!createRing(pt->north) || !createRing(pt->south)))
+            {
+                spdlog::error("[TcpForwardService::acceptClient] create ring buffers fail");
+                return false;
+            }
+
             // connect to target
-            if (!connect(curTime, pse, pt)) // status has been converted to 'CONNECT' in this function
+            if (!connect(pse, pt)) // status has been converted to 'CONNECT' in this function
             {
                 spdlog::error("[TcpForwardService::acceptClient] connect to target fail");
                 return false;
             }
 
-            // add north soc into epoll driver
-            if (!epollAddEndpoint(mEpollfd, pt->south, false, false, false) ||
-                !epollAddEndpoint(mEpollfd, pt->north, false, true, false))
+            // add north soc into epoll driver; 完成模式下由 connect 请求的完成事件驱动, 见 onConnected()
+            if (pt->mode != TUNMODE_URING &&
+                (!epollAddEndpoint(mpPoller, pt->south, false, false, mSetting.tcpEdgeTrigger) ||
+                 !epollAddEndpoint(mpPoller, pt->north, false, true, mSetting.tcpEdgeTrigger)))
             {
                 spdlog::error("[TcpForwardService::acceptClient] add endpoints into epoll driver fail");
                 return false;
@@ -642,7 +958,7 @@ void TcpForwardService::acceptClient(time_t curTime, Endpoint_t *pse)
                   pt->south->soc, pt->north->soc);
 }
 
-bool TcpForwardService::connect(time_t curTime, Endpoint_t *pse, Tunnel_t *pt)
+bool TcpForwardService::connect(Endpoint_t *pse, Tunnel_t *pt)
 {
     // connect to host
     auto addr = mTargetManager.getAddr(pse->soc);
@@ -651,23 +967,30 @@ bool TcpForwardService::connect(time_t curTime, Endpoint_t *pse, Tunnel_t *pt)
         spdlog::error("[TcpForwardService::connect] get host addr fail.");
         return false;
     }
+    else if (pt->mode == TUNMODE_URING)
+    {
+        // 由 io_uring 完成连接, 地址须在请求提交前有效
+        auto &conn = Endpoint::cold(pt->north)->conn;
+        conn.remoteAddr = *addr;
+        return mpUring->connect(pt->north, &conn.remoteAddr);
+    }
     else if (::connect(pt->north->soc, (sockaddr *)addr, sizeof(sockaddr_in)) < 0 &&
              errno != EALREADY &&
              errno != EINPROGRESS)
     {
         // report fail
-        mTargetManager.failReport(curTime, addr);
+        mTargetManager.failReport(pse->soc, addr);
         spdlog::error("[TcpForwardService::connect] connect fail. {} - {}",
                       errno, strerror(errno));
         return false;
     }
 
-    pt->north->conn.remoteAddr = *addr;
+    Endpoint::cold(pt->north)->conn.remoteAddr = *addr;
 
     return true;
 }
 
-void TcpForwardService::onRead(time_t curTime, int events, Endpoint_t *pe)
+void TcpForwardService::onRead(int events, Endpoint_t *pe)
 {
     auto pt = (Tunnel_t *)pe->container;
     // 状态机
@@ -701,75 +1024,18 @@ void TcpForwardService::onRead(time_t curTime, int events, Endpoint_t *pe)
         return;
     }
 
-    bool isRead = false;
-    while (true)
-    {
-        // is buffer full
-        if (pe->peer->bufferFull)
-        {
-            // 缓冲区满
-            break;
-        }
-
-        // 申请内存
-        auto pBufBlk = mpDynamicBuffer->getCurBufBlk();
-        if (pBufBlk == nullptr)
-        {
-            // out of buffer
-            break;
-        }
-
-        int nRet = recv(pe->soc, pBufBlk->buffer, pBufBlk->getBufSize(), 0);
-        if (nRet < 0)
-        {
-            if (errno == EAGAIN)
-            {
-                // 此次发送窗口已关闭
-            }
-            else
-            {
-                spdlog::debug("[TcpForwardService::onRead] soc[{}] recv fail: {} - [{}]",
-                              pe->soc, errno, strerror(errno));
-                pe->valid = false;
-                addToCloseList(pt);
-            }
-            break;
-        }
-        else if (nRet == 0)
-        {
-            // closed by peer
-            spdlog::debug("[TcpForwardService::onRead] soc[{}] closed by peer", pe->soc);
-            pe->valid = false;
-            addToCloseList(pt);
-            break;
-        }
-
-        // cut buffer
-        auto pBlk = mpDynamicBuffer->cut(nRet);
-        // attach to peer's send list
-        if (Endpoint::appendToSendList(pe->peer, pBlk))
-        {
-            epollResetEndpointMode(mEpollfd, pe->peer, true, true, false);
-        }
-
-        // statistic
-        if (pe->direction == TO_SOUTH)
-        {
-            mUp += nRet;
-            mTotalUp += nRet;
-        }
-
-        isRead = true;
-    }
+    bool isRead = pt->mode == TUNMODE_SPLICE
+                      ? spliceRead(pe)
+                      : pt->mode == TUNMODE_RING ? ringRead(pe) : bufferRead(pe);
 
     if (isRead)
     {
         // refresh timer
-        refreshTimer(curTime, pt);
+        refreshTimer(pt);
     }
 }
 
-void TcpForwardService::onWrite(time_t curTime, int events, Endpoint_t *pe)
+void TcpForwardService::onWrite(int events, Endpoint_t *pe)
 {
     if (!pe->valid)
     {
@@ -792,16 +1058,16 @@ void TcpForwardService::onWrite(time_t curTime, int events, Endpoint_t *pe)
         else
         {
             // 北向连接成功建立，添加南向 soc 到 epoll 中，并将被向 soc 修改为 收 模式
-            epollResetEndpointMode(mEpollfd, pt->north, true, false, false);
-            epollResetEndpointMode(mEpollfd, pt->south, true, false, false);
+            epollResetEndpointMode(mpPoller, pt->north, true, false, mSetting.tcpEdgeTrigger);
+            epollResetEndpointMode(mpPoller, pt->south, true, false, mSetting.tcpEdgeTrigger);
 
             setStatus(pt, TUNSTAT_ESTABLISHED);
 
             spdlog::debug("[TcpForwardService::doTunnelSoc] tunnel[{},{}] established.",
                           pt->south->soc, pt->north->soc);
 
-            // 切换定时器
-            switchTimer(mConnectTimer, mSessionTimer, curTime, pt);
+            // 切换超时时长
+            addToTimer(mSetting.sessionTimeout, pt);
         }
         return;
     case TUNSTAT_ESTABLISHED:
@@ -813,13 +1079,90 @@ void TcpForwardService::onWrite(time_t curTime, int events, Endpoint_t *pe)
         assert(false);
     }
 
-    bool pktReleased = false;
-    auto pkt = (DynamicBuffer::BufBlk_t *)pe->sendListHead;
-    while (pkt)
+    bool pktReleased = pt->mode == TUNMODE_SPLICE
+                           ? spliceWrite(pe)
+                           : pt->mode == TUNMODE_RING ? ringWrite(pe) : bufferWrite(pe);
+
+    if (pktReleased)
     {
-        // send data
-        assert(pkt->dataSize >= pkt->sent);
-        int nRet = send(pe->soc, pkt->buffer + pkt->sent, pkt->dataSize - pkt->sent, 0);
+        // refresh timer
+        refreshTimer(pt);
+
+        // 是否有缓冲区对象被释放，已有能力接收从南向来的数据
+        if (pt->stat == TUNSTAT_ESTABLISHED &&      // 只在链路建立的状态下接收来自对端的数据
+            pe->valid &&                            // 此节点有能力发送
+            pe->bufferFull &&                       // 此节点当前缓冲区满
+            pe->totalBufSize <= pe->lowWatermark && // 待发送数据已降至低水位
+            pe->peer->valid)                        // 对端有能力接收
+        {
+            pe->bufferFull = false;
+            epollResetEndpointMode(mpPoller, pe->peer, true, pe->peer->totalBufSize > 0, mSetting.tcpEdgeTrigger);
+            setReady(pe->peer, EPOLLIN);
+        }
+    }
+}
+
+bool TcpForwardService::bufferRead(Endpoint_t *pe)
+{
+    bool isRead = false;
+    while (true)
+    {
+        // is buffer full
+        if (pe->peer->bufferFull)
+        {
+            // 缓冲区满
+            break;
+        }
+
+        // 对端已失效 (如 write-through 发送失败), 停止接收, 由 close list 关闭 tunnel
+        if (!pe->peer->valid)
+        {
+            break;
+        }
+
+        // 本次事件的预算已用完, 留待下一轮
+        if (budgetExhausted(pe, EPOLLIN))
+        {
+            break;
+        }
+
+        // 所属 forward 的缓冲区预算已用完, 暂停接收直至其待发送数据减少
+        int64_t quota = budgetQuota(pe);
+        if (quota <= 0)
+        {
+            parkReader(pe);
+            break;
+        }
+
+        // 对端发送链表尾部的数据块尚有足够的空闲空间时, 直接接收至其尾部;
+        // 割取时的对齐余量小于 UNIT_ALLIGN_SIZE, 不追加, 以免大数据量读取多一次 recv
+        auto pTail = (DynamicBuffer::BufBlk_t *)pe->peer->sendListTail;
+        bool append = pTail && pTail->getBufSize() - pTail->dataSize >= DynamicBuffer::UNIT_ALLIGN_SIZE;
+        char *buf;
+        uint64_t room;
+        if (append)
+        {
+            buf = pTail->buffer + pTail->dataSize;
+            room = pTail->getBufSize() - pTail->dataSize;
+        }
+        else
+        {
+            // 申请内存
+            auto pBufBlk = mpDynamicBuffer->getCurBufBlk();
+            if (pBufBlk == nullptr)
+            {
+                // out of buffer, 暂停接收直至缓冲区被释放
+                parkReader(pe);
+                break;
+            }
+            buf = pBufBlk->buffer;
+            room = pBufBlk->getBufSize();
+        }
+
+        // 单次接收量不超过对端高水位的余量及预算
+        int nRet = recv(pe->soc, buf,
+                        min<uint64_t>(min<uint64_t>(room, quota), pe->peer->highWatermark - pe->peer->totalBufSize),
+                        0);
         if (nRet < 0)
         {
             if (errno == EAGAIN)
@@ -828,66 +1171,844 @@ void TcpForwardService::onWrite(time_t curTime, int events, Endpoint_t *pe)
             }
             else
             {
-                spdlog::debug("[TcpForwardService::onWrite] soc[{}] send fail: {} - [{}]",
+                spdlog::debug("[TcpForwardService::onRead] soc[{}] recv fail: {} - [{}]",
                               pe->soc, errno, strerror(errno));
                 pe->valid = false;
                 addToCloseList(pe);
             }
             break;
         }
+        else if (nRet == 0)
+        {
+            // closed by peer
+            spdlog::debug("[TcpForwardService::onRead] soc[{}] closed by peer", pe->soc);
+            pe->valid = false;
+            addToCloseList(pe);
+            break;
+        }
+
+        mIoBudget -= nRet;
+        if (append)
+        {
+            // 追加至尾部数据块, 发送链表非空, 对端已处于发送模式
+            pTail->dataSize += nRet;
+            pe->peer->totalBufSize += nRet;
+        }
         else
         {
-            pkt->sent += nRet;
-            pe->totalBufSize -= nRet;
-            assert(pe->totalBufSize >= 0);
+            // 接收已写入当前空闲块, 即使随后不割取 (全部发出或丢弃), 所在内存也需由 trim() 归还
+            mpDynamicBuffer->touch(buf, nRet);
 
-            if (pkt->dataSize == pkt->sent)
+            // 对端发送链表为空时, 先直接发送刚接收的数据 (write-through), 只将未发出的部分放入发送链表
+            int sent = pe->peer->sendListHead ? 0 : writeThrough(pe->peer, buf, nRet);
+            if (!pe->peer->valid)
             {
-                // 数据包发送完毕，可回收
-                auto next = pkt->next;
-                mpDynamicBuffer->release(pkt);
-                pkt = next;
+                // 对端发送失败, 丢弃数据, 不割取缓冲区
+                break;
             }
-
-            pktReleased = true;
-
-            // statistic
-            if (pe->direction == TO_SOUTH)
+            if (sent < nRet)
             {
-                mDown += nRet;
-                mTotalDown += nRet;
+                // cut buffer: 小数据量的读取 (如交互式会话) 多割取一些空间, 供后续读取追加;
+                // 多割取的部分不超过预算及对端高水位的余量, 使对端占用的缓冲区不超过高水位太多;
+                // 预算按割取的数据块大小计算, 追加的数据不再计入
+                uint64_t reserve = min<uint64_t>(min<uint64_t>(SMALL_READ_RESERVE, room),
+                                                 min<uint64_t>(quota, pe->peer->highWatermark - pe->peer->totalBufSize));
+                auto pBlk = mpDynamicBuffer->cut(max<uint64_t>(nRet, reserve));
+                chargeBudget(pe, pBlk->getBufSize());
+                pBlk->dataSize = nRet;
+                // attach to peer's send list
+                if (Endpoint::appendToSendList(pe->peer, pBlk))
+                {
+                    epollResetEndpointMode(mpPoller, pe->peer, !pe->bufferFull, true, mSetting.tcpEdgeTrigger);
+                }
+                pBlk->sent = sent;
+                pe->peer->totalBufSize -= sent;
             }
+            // 已全部发出时不割取, 缓冲区留待下次接收
         }
-    }
+        if (pe->peer->totalBufSize >= pe->peer->highWatermark)
+        {
+            pe->peer->bufferFull = true;
+        }
+
+        // statistic
+        if (pe->direction == TO_SOUTH)
+        {
+            mUp += nRet;
+            mTotalUp += nRet;
+        }
+
+        isRead = true;
+    }
+
+    if (pe->peer->bufferFull && pe->valid)
+    {
+        // 对端待发送数据已达高水位, 暂停接收, 待对端发送至低水位后 (onWrite) 恢复
+        epollResetEndpointMode(mpPoller, pe, false, pe->totalBufSize > 0, mSetting.tcpEdgeTrigger);
+    }
+
+    return isRead;
+}
+
+bool TcpForwardService::bufferWrite(Endpoint_t *pe)
+{
+    bool pktReleased = false;
+    auto pkt = (DynamicBuffer::BufBlk_t *)pe->sendListHead;
+    struct iovec iov[SEND_MAX_IOV];
+    while (pkt && !budgetExhausted(pe, EPOLLOUT))
+    {
+        // 将发送链表中的数据块汇集起来，一次发送
+        uint32_t iovCount = 0;
+        ssize_t gathered = 0;
+        for (auto p = pkt; p && iovCount < SEND_MAX_IOV; p = p->next, ++iovCount)
+        {
+            assert(p->dataSize >= p->sent);
+            iov[iovCount].iov_base = p->buffer + p->sent;
+            iov[iovCount].iov_len = p->dataSize - p->sent;
+            gathered += iov[iovCount].iov_len;
+        }
+
+        // send data
+        ssize_t nRet = writev(pe->soc, iov, iovCount);
+        if (nRet < 0)
+        {
+            if (errno == EAGAIN)
+            {
+                // 此次发送窗口已关闭
+            }
+            else
+            {
+                spdlog::debug("[TcpForwardService::onWrite] soc[{}] send fail: {} - [{}]",
+                              pe->soc, errno, strerror(errno));
+                pe->valid = false;
+                addToCloseList(pe);
+            }
+            break;
+        }
+        else
+        {
+            pe->totalBufSize -= nRet;
+            assert(pe->totalBufSize >= 0);
+            mIoBudget -= nRet;
+
+            // 将已发送的数据量记入各数据块
+            for (auto left = nRet; left > 0;)
+            {
+                uint64_t size = pkt->dataSize - pkt->sent;
+                if ((uint64_t)left < size)
+                {
+                    pkt->sent += left;
+                    break;
+                }
+
+                // 数据包发送完毕，可回收
+                left -= size;
+                auto next = pkt->next;
+                chargeBudget(pe, -(int64_t)pkt->getBufSize());
+                mpDynamicBuffer->release(pkt);
+                pkt = next;
+            }
+
+            pktReleased = true;
+
+            // statistic
+            if (pe->direction == TO_SOUTH)
+            {
+                mDown += nRet;
+                mTotalDown += nRet;
+            }
+
+            if (nRet < gathered)
+            {
+                // 此次发送窗口已关闭
+                break;
+            }
+        }
+    }
     if (pkt == nullptr)
     {
-        // 发送完毕
-        pe->sendListHead = pe->sendListTail = nullptr;
-        assert(pe->totalBufSize == 0);
-        epollResetEndpointMode(mEpollfd, pe, pe->valid, false, false);
+        // 发送完毕
+        pe->sendListHead = pe->sendListTail = nullptr;
+        assert(pe->totalBufSize == 0);
+        epollResetEndpointMode(mpPoller, pe, pe->valid && !pe->peer->bufferFull, false, mSetting.tcpEdgeTrigger);
+    }
+    else
+    {
+        // 还有数据需要发送
+        pe->sendListHead = pkt;
+        assert(pe->totalBufSize > 0);
+    }
+
+    return pktReleased;
+}
+
+int TcpForwardService::writeThrough(Endpoint_t *pe, const char *buf, int size)
+{
+    int nRet = send(pe->soc, buf, size, 0);
+    if (nRet < 0)
+    {
+        if (errno != EAGAIN)
+        {
+            spdlog::debug("[TcpForwardService::writeThrough] soc[{}] send fail: {} - [{}]",
+                          pe->soc, errno, strerror(errno));
+            pe->valid = false;
+            addToCloseList(pe);
+        }
+        return 0;
+    }
+
+    // statistic
+    if (pe->direction == TO_SOUTH)
+    {
+        mDown += nRet;
+        mTotalDown += nRet;
+    }
+
+    return nRet;
+}
+
+bool TcpForwardService::spliceRead(Endpoint_t *pe)
+{
+    bool isRead = false;
+    while (!pe->peer->bufferFull && !budgetExhausted(pe, EPOLLIN))
+    {
+        // 数据由 socket 直接移入对端管道, 不经过用户空间
+        int nRet = splice(pe->soc, nullptr, Endpoint::cold(pe->peer)->pipe[1], nullptr,
+                          pe->peer->highWatermark - pe->peer->totalBufSize,
+                          SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (nRet < 0)
+        {
+            if (errno == EAGAIN)
+            {
+                // socket 中无数据, 或管道已满 (管道容量按页占用, 少量数据也可能将其占满)
+                int pending = 0;
+                if (ioctl(pe->soc, FIONREAD, &pending) == 0 && pending > 0)
+                {
+                    pe->peer->bufferFull = true;
+                }
+            }
+            else
+            {
+                spdlog::debug("[TcpForwardService::spliceRead] soc[{}] splice fail: {} - [{}]",
+                              pe->soc, errno, strerror(errno));
+                pe->valid = false;
+                addToCloseList(pe);
+            }
+            break;
+        }
+        else if (nRet == 0)
+        {
+            // closed by peer
+            spdlog::debug("[TcpForwardService::spliceRead] soc[{}] closed by peer", pe->soc);
+            pe->valid = false;
+            addToCloseList(pe);
+            break;
+        }
+
+        // 管道由空变为非空时, 开启对端的发送
+        if (pe->peer->totalBufSize == 0)
+        {
+            epollResetEndpointMode(mpPoller, pe->peer, !pe->bufferFull, true, mSetting.tcpEdgeTrigger);
+            setReady(pe->peer, EPOLLOUT);
+        }
+        pe->peer->totalBufSize += nRet;
+        mIoBudget -= nRet;
+        if (pe->peer->totalBufSize >= pe->peer->highWatermark)
+        {
+            pe->peer->bufferFull = true;
+        }
+
+        // statistic
+        if (pe->direction == TO_SOUTH)
+        {
+            mUp += nRet;
+            mTotalUp += nRet;
+        }
+
+        isRead = true;
+    }
+
+    if (pe->peer->bufferFull && pe->valid)
+    {
+        // 对端管道已满或已达高水位, 暂停接收, 待对端发送至低水位后 (onWrite) 恢复
+        epollResetEndpointMode(mpPoller, pe, false, pe->totalBufSize > 0, mSetting.tcpEdgeTrigger);
+    }
+
+    return isRead;
+}
+
+bool TcpForwardService::spliceWrite(Endpoint_t *pe)
+{
+    bool isWritten = false;
+    while (pe->totalBufSize > 0 && !budgetExhausted(pe, EPOLLOUT))
+    {
+        // 数据由管道直接移入 socket
+        int nRet = splice(Endpoint::cold(pe)->pipe[0], nullptr, pe->soc, nullptr,
+                          pe->totalBufSize,
+                          SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (nRet < 0)
+        {
+            if (errno == EAGAIN)
+            {
+                // 此次发送窗口已关闭
+            }
+            else
+            {
+                spdlog::debug("[TcpForwardService::spliceWrite] soc[{}] splice fail: {} - [{}]",
+                              pe->soc, errno, strerror(errno));
+                pe->valid = false;
+                addToCloseList(pe);
+            }
+            break;
+        }
+        else if (nRet == 0)
+        {
+            break;
+        }
+
+        pe->totalBufSize -= nRet;
+        assert(pe->totalBufSize >= 0);
+        mIoBudget -= nRet;
+
+        isWritten = true;
+
+        // statistic
+        if (pe->direction == TO_SOUTH)
+        {
+            mDown += nRet;
+            mTotalDown += nRet;
+        }
+    }
+    if (pe->totalBufSize == 0)
+    {
+        // 发送完毕
+        epollResetEndpointMode(mpPoller, pe, pe->valid && !pe->peer->bufferFull, false, mSetting.tcpEdgeTrigger);
+    }
+
+    return isWritten;
+}
+
+bool TcpForwardService::ringRead(Endpoint_t *pe)
+{
+    bool isRead = false;
+    auto pRing = (RingBuffer *)Endpoint::cold(pe->peer)->ring;
+    while (!pe->peer->bufferFull && !budgetExhausted(pe, EPOLLIN))
+    {
+        // 直接接收至对端环形缓冲区的连续空闲区域 (高水位不超过其容量), 无需数据块
+        int nRet = recv(pe->soc, pRing->getBuffer(), pe->peer->highWatermark - pe->peer->totalBufSize, 0);
+        if (nRet < 0)
+        {
+            if (errno == EAGAIN)
+            {
+                // 此次接收窗口已关闭
+            }
+            else
+            {
+                spdlog::debug("[TcpForwardService::ringRead] soc[{}] recv fail: {} - [{}]",
+                              pe->soc, errno, strerror(errno));
+                pe->valid = false;
+                addToCloseList(pe);
+            }
+            break;
+        }
+        else if (nRet == 0)
+        {
+            // closed by peer
+            spdlog::debug("[TcpForwardService::ringRead] soc[{}] closed by peer", pe->soc);
+            pe->valid = false;
+            addToCloseList(pe);
+            break;
+        }
+
+        pRing->incDataSize(nRet);
+
+        // 缓冲区由空变为非空时, 开启对端的发送
+        if (pe->peer->totalBufSize == 0)
+        {
+            epollResetEndpointMode(mpPoller, pe->peer, !pe->bufferFull, true, mSetting.tcpEdgeTrigger);
+            setReady(pe->peer, EPOLLOUT);
+        }
+        pe->peer->totalBufSize += nRet;
+        mIoBudget -= nRet;
+        if (pe->peer->totalBufSize >= pe->peer->highWatermark)
+        {
+            pe->peer->bufferFull = true;
+        }
+
+        // statistic
+        if (pe->direction == TO_SOUTH)
+        {
+            mUp += nRet;
+            mTotalUp += nRet;
+        }
+
+        isRead = true;
+    }
+
+    if (pe->peer->bufferFull && pe->valid)
+    {
+        // 对端待发送数据已达高水位, 暂停接收, 待对端发送至低水位后 (onWrite) 恢复
+        epollResetEndpointMode(mpPoller, pe, false, pe->totalBufSize > 0, mSetting.tcpEdgeTrigger);
+    }
+
+    return isRead;
+}
+
+bool TcpForwardService::ringWrite(Endpoint_t *pe)
+{
+    bool isWritten = false;
+    auto pRing = (RingBuffer *)Endpoint::cold(pe)->ring;
+    while (pe->totalBufSize > 0 && !budgetExhausted(pe, EPOLLOUT))
+    {
+        // 待发送数据在镜像映射中总是连续的, 一次 send 即可
+        int nRet = send(pe->soc, pRing->getData(), pe->totalBufSize, 0);
+        if (nRet < 0)
+        {
+            if (errno == EAGAIN)
+            {
+                // 此次发送窗口已关闭
+            }
+            else
+            {
+                spdlog::debug("[TcpForwardService::ringWrite] soc[{}] send fail: {} - [{}]",
+                              pe->soc, errno, strerror(errno));
+                pe->valid = false;
+                addToCloseList(pe);
+            }
+            break;
+        }
+        else if (nRet == 0)
+        {
+            break;
+        }
+
+        pRing->incFreeSize(nRet);
+        pe->totalBufSize -= nRet;
+        assert(pe->totalBufSize >= 0 && (uint64_t)pe->totalBufSize == pRing->dataSize());
+        mIoBudget -= nRet;
+
+        isWritten = true;
+
+        // statistic
+        if (pe->direction == TO_SOUTH)
+        {
+            mDown += nRet;
+            mTotalDown += nRet;
+        }
+    }
+    if (pe->totalBufSize == 0)
+    {
+        // 发送完毕
+        epollResetEndpointMode(mpPoller, pe, pe->valid && !pe->peer->bufferFull, false, mSetting.tcpEdgeTrigger);
+    }
+
+    return isWritten;
+}
+
+bool TcpForwardService::initRecvBufs()
+{
+    // 缓冲区个数为 2 的幂, 至多占用缓冲区的一半
+    uint32_t count = URING_BUF_COUNT;
+    while (count && count * URING_BUF_SIZE > mSetting.bufferSize / 2)
+    {
+        count >>= 1;
+    }
+    if (!count)
+    {
+        spdlog::error("[TcpForwardService::initRecvBufs] buffer size {} is too small", mSetting.bufferSize);
+        return false;
+    }
+
+    vector<uint64_t> sizes(count, URING_BUF_SIZE);
+    mRecvBufs.resize(count);
+    if (mpDynamicBuffer->getBufBlks(sizes.data(), count, mRecvBufs.data()) != count)
+    {
+        spdlog::error("[TcpForwardService::initRecvBufs] alloc {} buffers fail", count);
+        return false;
+    }
+    if (!mpUring->setupBufRing(count))
+    {
+        return false;
+    }
+    for (uint32_t bid = 0; bid < count; ++bid)
+    {
+        provideRecvBuf(bid);
+    }
+
+    spdlog::debug("[TcpForwardService::initRecvBufs] reactor[{}] provides {} buffers of {} bytes",
+                  mReactorId, count, URING_BUF_SIZE);
+    return true;
+}
+
+void TcpForwardService::releaseRecvBufs()
+{
+    for (auto pBufBlk : mRecvBufs)
+    {
+        pBufBlk && (mpDynamicBuffer->release(pBufBlk), true);
     }
-    else
+    mRecvBufs.clear();
+    mFreeRecvBufs = 0;
+}
+
+void TcpForwardService::doCompletion(const UringPoller::Completion_t &c)
+{
+    switch (c.op)
     {
-        // 还有数据需要发送
-        pe->sendListHead = pkt;
-        assert(pe->totalBufSize > 0);
+    case UringPoller::OP_ACCEPT:
+        if (c.res >= 0)
+        {
+            c.pe ? acceptClient(c.pe, c.res) : (void)::close(c.res);
+        }
+        else if (c.res != -ECANCELED)
+        {
+            spdlog::error("[TcpForwardService::doCompletion] accept fail: {} - {}", -c.res, strerror(-c.res));
+        }
+
+        // multishot accept 出错时终止, 重新提交
+        if (!c.more && c.pe && c.res != -ECANCELED && !mpUring->accept(c.pe))
+        {
+            spdlog::error("[TcpForwardService::doCompletion] re-arm accept of service[{}] fail", c.pe->soc);
+        }
+        break;
+    case UringPoller::OP_CONNECT:
+        c.pe && (onConnected(c.pe, c.res), true);
+        break;
+    case UringPoller::OP_RECV:
+        onRecv(c);
+        break;
+    case UringPoller::OP_SEND:
+        onSend(c);
+        break;
+    default:
+        spdlog::critical("[TcpForwardService::doCompletion] invalid request: {}", (int)c.op);
+        assert(false);
     }
+}
 
-    if (pktReleased)
+void TcpForwardService::onConnected(Endpoint_t *pe, int res)
+{
+    auto pt = (Tunnel_t *)pe->container;
+    if (pt->stat != TUNSTAT_CONNECT)
+    {
+        // 已超时或关闭
+        return;
+    }
+    if (res < 0)
+    {
+        // 连接失败
+        spdlog::error("[TcpForwardService::onConnected] tunnel-soc[{}] connect fail. {} - {}",
+                      pe->soc, -res, strerror(-res));
+        addToCloseList(pt);
+        return;
+    }
+
+    setStatus(pt, TUNSTAT_ESTABLISHED);
+
+    spdlog::debug("[TcpForwardService::onConnected] tunnel[{},{}] established.",
+                  pt->south->soc, pt->north->soc);
+
+    // 切换超时时长
+    addToTimer(mSetting.sessionTimeout, pt);
+
+    // 双向开始接收
+    if (!mpUring->recv(pt->south) || !mpUring->recv(pt->north))
+    {
+        addToCloseList(pt);
+    }
+}
+
+void TcpForwardService::onRecv(const UringPoller::Completion_t &c)
+{
+    auto pe = c.pe;
+    if (c.bid != UringPoller::NO_BUFFER)
+    {
+        --mFreeRecvBufs;
+        if (!pe)
+        {
+            // 端点已释放, 归还缓冲区
+            provideRecvBuf(c.bid);
+            return;
+        }
+    }
+    if (!pe)
+    {
+        return;
+    }
+
+    auto pt = (Tunnel_t *)pe->container;
+    if (c.res > 0)
     {
+        if (pt->stat != TUNSTAT_ESTABLISHED || !pe->valid || !pe->peer->valid)
+        {
+            spdlog::trace("[TcpForwardService::onRecv] drop data of soc[{}] on broken tunnel", pe->soc);
+            provideRecvBuf(c.bid);
+            addToCloseList(pt);
+            return;
+        }
+
+        // 经同一缓冲区发往对端, 发送完毕后继续接收
+        pe->peer->totalBufSize = c.res;
+        if (!mpUring->relay(pe->peer, c.bid, mRecvBufs[c.bid]->buffer, c.res, pe))
+        {
+            provideRecvBuf(c.bid);
+            pe->peer->totalBufSize = 0;
+            pe->valid = false;
+            addToCloseList(pt);
+            return;
+        }
+
+        // statistic
+        if (pe->direction == TO_SOUTH)
+        {
+            mUp += c.res;
+            mTotalUp += c.res;
+        }
+
         // refresh timer
-        refreshTimer(curTime, pt);
+        refreshTimer(pt);
+        return;
+    }
 
-        // 是否有缓冲区对象被释放，已有能力接收从南向来的数据
-        if (pt->stat == TUNSTAT_ESTABLISHED && // 只在链路建立的状态下接收来自对端的数据
-            pe->valid &&                       // 此节点有能力发送
-            pe->bufferFull &&                  // 此节点当前缓冲区满
-            pe->peer->valid)                   // 对端有能力接收
+    switch (c.res)
+    {
+    case 0:
+        // closed by peer
+        spdlog::debug("[TcpForwardService::onRecv] soc[{}] closed by peer", pe->soc);
+        pe->valid = false;
+        addToCloseList(pt);
+        break;
+    case -ENOBUFS:
+        // 缓冲区环为空, 待缓冲区归还后恢复接收
+        mStarvedList.push_back(Endpoint::handle(pe));
+        break;
+    case -ECANCELED:
+        // 链接的发送失败 (由 onSend 关闭 tunnel), 或端点已移除
+        break;
+    default:
+        spdlog::debug("[TcpForwardService::onRecv] soc[{}] recv fail: {} - [{}]",
+                      pe->soc, -c.res, strerror(-c.res));
+        pe->valid = false;
+        addToCloseList(pt);
+        break;
+    }
+}
+
+void TcpForwardService::onSend(const UringPoller::Completion_t &c)
+{
+    // 缓冲区已发出 (或发送失败), 归还缓冲区环
+    provideRecvBuf(c.bid);
+
+    auto pe = c.pe;
+    if (!pe)
+    {
+        return;
+    }
+
+    auto pt = (Tunnel_t *)pe->container;
+    int64_t size = pe->totalBufSize;
+    pe->totalBufSize = 0;
+    if (c.res < size)
+    {
+        // 未全部发出, 其后链接的接收已被撤销
+        if (c.res != -ECANCELED)
         {
-            pe->bufferFull = false;
-            epollResetEndpointMode(mEpollfd, pe->peer, true, pe->peer->sendListHead, false);
+            spdlog::debug("[TcpForwardService::onSend] soc[{}] send {} of {} bytes: {}",
+                          pe->soc, c.res, size, strerror(c.res < 0 ? -c.res : EIO));
+        }
+        pe->valid = false;
+        addToCloseList(pt);
+        return;
+    }
+
+    // statistic
+    if (pe->direction == TO_SOUTH)
+    {
+        mDown += c.res;
+        mTotalDown += c.res;
+    }
+
+    // refresh timer
+    refreshTimer(pt);
+
+    // 关闭中的 tunnel, 待发送的数据已发出
+    pt->stat == TUNSTAT_BROKEN && (addToCloseList(pt), true);
+}
+
+void TcpForwardService::resumeStarvedReaders()
+{
+    // 按等待顺序恢复接收, 每个读端至多占用一个缓冲区; 其余读端继续等待
+    size_t count = 0;
+    for (uint32_t available = mFreeRecvBufs; count < mStarvedList.size() && available > 0; ++count)
+    {
+        auto pe = Endpoint::fromHandle(mStarvedList[count]);
+        if (pe && pe->valid && ((Tunnel_t *)pe->container)->stat == TUNSTAT_ESTABLISHED)
+        {
+            --available;
+            if (!mpUring->recv(pe))
+            {
+                pe->valid = false;
+                addToCloseList(pe);
+            }
+        }
+    }
+    mStarvedList.erase(mStarvedList.begin(), mStarvedList.begin() + count);
+}
+
+bool TcpForwardService::loadServiceSetting(const Forward &forward, ServiceSetting_t &setting)
+{
+    // mode: buffer | splice | ring
+    auto mode = forward.getOption("mode", "buffer");
+    if (mode == "buffer")
+    {
+        setting.mode = TUNMODE_BUFFER;
+    }
+    else if (mode == "splice")
+    {
+        setting.mode = TUNMODE_SPLICE;
+    }
+    else if (mode == "ring")
+    {
+        setting.mode = TUNMODE_RING;
+    }
+    else
+    {
+        spdlog::error("[TcpForwardService::loadServiceSetting] unsupported mode: {}", mode);
+        return false;
+    }
+
+    // high, low: watermarks of pending data per endpoint, unit: KB
+    auto getKBytes = [&forward](const char *name, int64_t defaultValue, int64_t &value) -> bool {
+        auto str = forward.getOption(name, "");
+        if (str.empty())
+        {
+            value = defaultValue;
+            return true;
+        }
+        char *end = nullptr;
+        value = strtoll(str.c_str(), &end, 10) * 1024;
+        return *end == 0 && value >= 0;
+    };
+    if (!getKBytes("high", mSetting.bufferPerSessionLimit, setting.highWatermark) ||
+        !getKBytes("low", setting.highWatermark / 2, setting.lowWatermark) ||
+        setting.highWatermark == 0 ||
+        setting.highWatermark > UINT32_MAX || // 端点中的水位为 32 位
+        setting.lowWatermark >= setting.highWatermark)
+    {
+        spdlog::error("[TcpForwardService::loadServiceSetting] invalid watermarks, high: {}, low: {}",
+                      forward.getOption("high", ""), forward.getOption("low", ""));
+        return false;
+    }
+
+    // budget: buffer reserved for the forward in each reactor, unit: KB
+    if (!getKBytes("budget", 0, setting.budget))
+    {
+        spdlog::error("[TcpForwardService::loadServiceSetting] invalid budget: {}", forward.getOption("budget", ""));
+        return false;
+    }
+    setting.budgetId = 0;
+
+    return true;
+}
+
+bool TcpForwardService::createPipe(Endpoint_t *pe)
+{
+    auto pCold = Endpoint::cold(pe);
+    if (pipe2(pCold->pipe, O_NONBLOCK | O_CLOEXEC))
+    {
+        spdlog::error("[TcpForwardService::createPipe] create pipe fail. {} - {}",
+                      errno, strerror(errno));
+        pCold->pipe[0] = pCold->pipe[1] = 0;
+        return false;
+    }
+
+    // 以高水位作为管道容量, 设置失败时沿用系统默认值
+    fcntl(pCold->pipe[1], F_SETPIPE_SZ, (int)pe->highWatermark);
+    int size = fcntl(pCold->pipe[1], F_GETPIPE_SZ);
+    if (size <= 0)
+    {
+        spdlog::error("[TcpForwardService::createPipe] get pipe size fail. {} - {}",
+                      errno, strerror(errno));
+        closePipe(pe);
+        return false;
+    }
+    pCold->pipeSize = size;
+
+    // 水位不超过管道的实际容量
+    if (pe->highWatermark > (uint32_t)size)
+    {
+        pe->highWatermark = size;
+        pe->lowWatermark = min(pe->lowWatermark, pe->highWatermark / 2);
+    }
+
+    return true;
+}
+
+void TcpForwardService::closePipe(Endpoint_t *pe)
+{
+    auto pCold = Endpoint::cold(pe);
+    pCold->pipe[0] && (::close(pCold->pipe[0]), (pCold->pipe[0] = 0));
+    pCold->pipe[1] && (::close(pCold->pipe[1]), (pCold->pipe[1] = 0));
+    pCold->pipeSize = 0;
+}
+
+bool TcpForwardService::createRing(Endpoint_t *pe)
+{
+    // 以高水位作为环形缓冲区容量, 同一服务的端点容量相同, 按容量从池中复用
+    if (pe->highWatermark > RING_MAX_CAPACITY)
+    {
+        pe->highWatermark = RING_MAX_CAPACITY;
+        pe->lowWatermark = min(pe->lowWatermark, pe->highWatermark / 2);
+    }
+
+    auto &pool = mRingPool[pe->highWatermark];
+    RingBuffer *pRing;
+    if (!pool.empty())
+    {
+        pRing = pool.front();
+        pool.pop_front();
+    }
+    else if (!(pRing = RingBuffer::alloc(pe->highWatermark)))
+    {
+        spdlog::error("[TcpForwardService::createRing] alloc ring buffer[{}] fail", pe->highWatermark);
+        return false;
+    }
+    pRing->init();
+    Endpoint::cold(pe)->ring = pRing;
+
+    return true;
+}
+
+void TcpForwardService::closeRing(Endpoint_t *pe)
+{
+    auto pCold = Endpoint::cold(pe);
+    if (!pCold->ring)
+    {
+        return;
+    }
+
+    // 归还至池中, 超出上限的直接释放
+    auto &pool = mRingPool[pe->highWatermark];
+    if (pool.size() < RING_POOL_LIMIT)
+    {
+        pool.push_back((RingBuffer *)pCold->ring);
+    }
+    else
+    {
+        RingBuffer::release((RingBuffer *)pCold->ring);
+    }
+    pCold->ring = nullptr;
+}
+
+void TcpForwardService::releaseRingPool()
+{
+    for (auto &it : mRingPool)
+    {
+        for (auto pRing : it.second)
+        {
+            RingBuffer::release(pRing);
         }
     }
+    mRingPool.clear();
 }
 
 void TcpForwardService::closeTunnel(Tunnel_t *pt)
@@ -896,15 +2017,15 @@ void TcpForwardService::closeTunnel(Tunnel_t *pt)
     {
     case TUNSTAT_BROKEN:
     {
-        if ((pt->north->sendListHead && pt->north->valid) ||
-            (pt->south->sendListHead && pt->south->valid))
+        if ((pt->north->totalBufSize > 0 && pt->north->valid) ||
+            (pt->south->totalBufSize > 0 && pt->south->valid))
         {
-            Endpoint_t *pe = (pt->north->sendListHead && pt->north->valid)
+            Endpoint_t *pe = (pt->north->totalBufSize > 0 && pt->north->valid)
                                  ? pt->north
                                  : pt->south;
 
-            // send last data
-            epollResetEndpointMode(mEpollfd, pe, false, true, false);
+            // send last data; 完成模式下发送请求已提交, 发送完毕后 (onSend) 再次关闭
+            pt->mode != TUNMODE_URING && epollResetEndpointMode(mpPoller, pe, false, true, mSetting.tcpEdgeTrigger);
         }
         else
         {
@@ -919,18 +2040,32 @@ void TcpForwardService::closeTunnel(Tunnel_t *pt)
                       pt->south->soc, pt->north->soc);
 
         // remove from timer
-        removeFromTimer(mReleaseTimer, pt);
+        removeFromTimer(pt);
 
         // release endpoint buffer
         releaseEndpointBuffer(pt->north);
         releaseEndpointBuffer(pt->south);
+        unparkReader(pt->north);
+        unparkReader(pt->south);
 
-        // remove endpoints from epoll
-        epollRemoveTunnel(mEpollfd, pt);
+        // remove endpoints from epoll; 完成模式下撤销端点已提交的请求 (南向端点于连接建立后才提交请求)
+        if (pt->mode == TUNMODE_URING)
+        {
+            mpUring && mpUring->submitted(pt->north) && (epollRemoveEndpoint(mpPoller, pt->north), true);
+            mpUring && mpUring->submitted(pt->south) && (epollRemoveEndpoint(mpPoller, pt->south), true);
+        }
+        else
+        {
+            epollRemoveTunnel(mpPoller, pt);
+        }
 
         // close socket
         pt->north->soc && (::close(pt->north->soc), pt->north->soc = 0);
         pt->south->soc && (::close(pt->south->soc), pt->south->soc = 0);
+        closePipe(pt->north);
+        closePipe(pt->south);
+        closeRing(pt->north);
+        closeRing(pt->south);
 
         // release objects
         Endpoint::releaseEndpoint(pt->north);
@@ -944,14 +2079,18 @@ void TcpForwardService::closeTunnel(Tunnel_t *pt)
                       pt->south->soc, pt->north->soc);
 
         // remove from timer
-        removeFromTimer(mConnectTimer, pt);
+        removeFromTimer(pt);
 
         // remove endpoints from epoll
-        epollRemoveTunnel(mEpollfd, pt);
+        epollRemoveTunnel(mpPoller, pt);
 
         // close socket
         pt->north->soc && (::close(pt->north->soc), pt->north->soc = 0);
         pt->south->soc && (::close(pt->south->soc), pt->south->soc = 0);
+        closePipe(pt->north);
+        closePipe(pt->south);
+        closeRing(pt->north);
+        closeRing(pt->south);
 
         // release objects
         Endpoint::releaseEndpoint(pt->north);
@@ -965,20 +2104,121 @@ void TcpForwardService::closeTunnel(Tunnel_t *pt)
     }
 }
 
-void TcpForwardService::refreshTimer(time_t curTime, Tunnel_t *pt)
+void TcpForwardService::parkReader(Endpoint_t *pe)
 {
-    switch (pt->stat)
+    auto pCold = Endpoint::cold(pe);
+    if (!pCold->parked)
+    {
+        // append to tail
+        pCold->prev = mpParkedTail;
+        pCold->next = nullptr;
+        mpParkedTail ? (Endpoint::cold(mpParkedTail)->next = pe) : (mpParkedHead = pe);
+        mpParkedTail = pe;
+        pCold->parked = true;
+    }
+
+    // 关闭接收, 避免水平触发的 EPOLLIN 空转
+    epollResetEndpointMode(mpPoller, pe, false, pe->totalBufSize > 0, mSetting.tcpEdgeTrigger);
+}
+
+void TcpForwardService::unparkReader(Endpoint_t *pe)
+{
+    auto pCold = Endpoint::cold(pe);
+    if (!pCold->parked)
+    {
+        return;
+    }
+
+    pCold->prev ? (Endpoint::cold(pCold->prev)->next = pCold->next) : (mpParkedHead = pCold->next);
+    pCold->next ? (Endpoint::cold(pCold->next)->prev = pCold->prev) : (mpParkedTail = pCold->prev);
+    pCold->prev = pCold->next = nullptr;
+    pCold->parked = false;
+}
+
+void TcpForwardService::resumeParkedReaders()
+{
+    if (mpParkedHead == nullptr || !mpDynamicBuffer->hasFreeBlk())
+    {
+        return;
+    }
+
+    // 按停放顺序恢复接收, 每个读端预计占用对端高水位的余量, 直至可用缓冲区分配完毕;
+    // 其余读端继续等待下一次释放
+    int64_t available = mpDynamicBuffer->freeSize();
+    for (auto pe = mpParkedHead; pe && available > 0;)
+    {
+        auto next = Endpoint::cold(pe)->next;
+        if (budgetQuota(pe) <= 0)
+        {
+            // 所属 forward 的预算已用完, 继续等待其待发送数据减少
+            pe = next;
+            continue;
+        }
+        unparkReader(pe);
+
+        if (((Tunnel_t *)pe->container)->stat == TUNSTAT_ESTABLISHED &&
+            pe->valid &&
+            !pe->peer->bufferFull) // 对端缓冲区满时, 由对端发送至低水位后 (onWrite) 恢复
+        {
+            epollResetEndpointMode(mpPoller, pe, true, pe->totalBufSize > 0, mSetting.tcpEdgeTrigger);
+            setReady(pe, EPOLLIN);
+            available -= pe->peer->highWatermark - pe->peer->totalBufSize;
+        }
+        pe = next;
+    }
+}
+
+void TcpForwardService::defragment()
+{
+    // 记录发送链表首尾数据块所属的端点, 数据块移动后据此修正端点的链表指针
+    // (所有 tunnel 都位于时间轮中)
+    map<DynamicBuffer::BufBlk_t *, Endpoint_t *> heads;
+    map<DynamicBuffer::BufBlk_t *, Endpoint_t *> tails;
+    mTimerWheel.forEach([&](TimingWheel::Entity_t *entity) {
+        auto pt = (Tunnel_t *)entity->container;
+        Endpoint_t *endpoints[2] = {pt->south, pt->north};
+        for (auto pe : endpoints)
+        {
+            if (pe && pe->sendListHead)
+            {
+                heads[(DynamicBuffer::BufBlk_t *)pe->sendListHead] = pe;
+                tails[(DynamicBuffer::BufBlk_t *)pe->sendListTail] = pe;
+            }
+        }
+    });
+    if (heads.empty())
     {
-    case TUNSTAT_ESTABLISHED:
-        refreshTimer(mSessionTimer, curTime, pt);
-        break;
-    case TUNSTAT_BROKEN:
-        refreshTimer(mReleaseTimer, curTime, pt);
         return;
-    default:
-        spdlog::error("[TcpForwardService::refreshTimer] tunnel[{}:{}] with invalid tunnel status: {}",
-                      pt->south->soc, pt->north->soc, pt->stat);
-        assert(false);
+    }
+
+    auto moved = mpDynamicBuffer->defragment(DEFRAG_STEP_SIZE, [&](DynamicBuffer::BufBlk_t *pOld, DynamicBuffer::BufBlk_t *pNew) {
+        pNew->prev ? (pNew->prev->next = pNew) : (heads[pOld]->sendListHead = pNew);
+        pNew->next ? (pNew->next->prev = pNew) : (tails[pOld]->sendListTail = pNew);
+    });
+
+    spdlog::debug("[TcpForwardService::defragment] reactor[{}] moved {} bytes", mReactorId, moved);
+}
+
+int64_t TcpForwardService::budgetQuota(Endpoint_t *pe)
+{
+    auto pBudget = mBudgetTable[((Tunnel_t *)pe->container)->budget];
+    if (pBudget && pBudget->limit)
+    {
+        // 使用为其预留的缓冲区
+        return pBudget->limit - pBudget->used;
+    }
+
+    // 未设预算的 forward 共享其余缓冲区, 不占用其他 forward 预留而尚未使用的部分
+    return mpDynamicBuffer->freeSize() - (mReservedLimit - mReservedUsed);
+}
+
+void TcpForwardService::chargeBudget(Endpoint_t *pe, int64_t size)
+{
+    auto pBudget = mBudgetTable[((Tunnel_t *)pe->container)->budget];
+    if (pBudget)
+    {
+        pBudget->used += size;
+        pBudget->limit && (mReservedUsed += size);
     }
 }
 
@@ -986,14 +2226,19 @@ void TcpForwardService::releaseEndpointBuffer(Endpoint_t *pe)
 {
     if (pe && pe->sendListHead)
     {
-        auto pkt = (DynamicBuffer::BufBlk_t *)pe->sendListHead;
-        while (pkt)
+        int64_t committed = 0;
+        for (auto p = (DynamicBuffer::BufBlk_t *)pe->sendListHead; p; p = p->next)
         {
-            auto next = pkt->next;
-            mpDynamicBuffer->release(pkt);
-            pkt = next;
+            committed += p->getBufSize();
         }
+        mpDynamicBuffer->releaseList((DynamicBuffer::BufBlk_t *)pe->sendListHead);
         pe->sendListHead = pe->sendListTail = nullptr;
+        chargeBudget(pe, -committed);
+        pe->totalBufSize = 0;
+    }
+    else if (pe)
+    {
+        // splice mode: data in pipe is dropped along with the pipe
         pe->totalBufSize = 0;
     }
 }
@@ -11,17 +11,24 @@
 #ifndef __MAPPER_LINK_TCPFORWARDSERVICE_H__
 #define __MAPPER_LINK_TCPFORWARDSERVICE_H__
 
+#include <atomic>
 #include <list>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
 #include <thread>
+#include <vector>
 #include "forward.h"
+#include "poller.h"
 #include "service.h"
 #include "targetMgr.h"
+#include "uringPoller.h"
 #include "utils.h"
 #include "../buffer/dynamicBuffer.h"
-#include "../utils/timerList.h"
+#include "../buffer/ringBuffer.h"
+#include "../utils/clock.h"
+#include "../utils/timingWheel.h"
 
 namespace mapper
 {
@@ -32,13 +39,39 @@ class TcpForwardService : public Service
 {
 protected:
     static const uint32_t EPOLL_THREAD_RETRY_INTERVAL;
-    static const uint32_t EPOLL_MAX_EVENTS;
-    static const uint32_t INTERVAL_EPOLL_WAIT_TIME;
+    static const uint32_t SEND_MAX_IOV; // max blocks gathered by one writev
+    static const uint64_t DEFRAG_STEP_SIZE; // max bytes moved by one defragment pass
+    static const uint64_t SMALL_READ_RESERVE; // min buffer size cut for a read, the rest is left for appending
+    static const int64_t RING_MAX_CAPACITY; // max capacity of a ring mode endpoint's RingBuffer
+    static const uint32_t RING_POOL_LIMIT;  // max idle RingBuffers kept per capacity
+    static const uint64_t URING_BUF_SIZE;   // size of a buffer in the io_uring provided buffer ring
+    static const uint32_t URING_BUF_COUNT;  // max buffers in the provided buffer ring, a power of 2
+
+    // settings of a service (listener), loaded from the options of its forward
+    struct ServiceSetting_t
+    {
+        TunnelMode_t mode;
+        int64_t highWatermark; // bytes, pause reading when the peer's pending data reaches it
+        int64_t lowWatermark;  // bytes, resume reading when the peer's pending data drains to it
+        int64_t budget;        // bytes of the reactor's buffer reserved for the forward, 0: no reservation
+        uint32_t budgetId;     // id of the forward's Budget_t in mBudgetTable, referred by Tunnel_t::budget
+    };
+
+    // buffer occupancy of a forward in a reactor, created in init() and kept across env re-initialization
+    struct Budget_t
+    {
+        int64_t limit;         // bytes reserved for the forward, 0: shares the unreserved buffer
+        volatile int64_t used; // bytes of buffer blocks holding pending data of the forward's tunnels (buffer mode)
+        uint32_t id;           // index in mBudgetTable
+    };
 
 protected:
     TcpForwardService(const TcpForwardService &) : Service(""){};
     TcpForwardService &operator=(const TcpForwardService &) { return *this; }
 
+    // 额外的 reactor 实例：由首个 reactor 创建并持有，各自拥有独立的 epoll 线程
+    TcpForwardService(uint32_t reactorId);
+
 public:
     TcpForwardService();
     virtual ~TcpForwardService();
@@ -52,74 +85,128 @@ public:
     std::string getStatistic(time_t curTime) override;
     void resetStatistic() override;
 
-    void postProcess(time_t curTime);
-    void scanTimeout(time_t curTime);
+    void postProcess();
+    void scanTimeout();
 
 protected:
     void epollThread();
     bool initEnv();
     void closeEnv();
-    bool doEpoll(int epollfd);
-    void doTunnelSoc(time_t curTime, Endpoint_t *pe, uint32_t events);
+    bool doEpoll();
+    void doTunnelSoc(Endpoint_t *pe, uint32_t events);
+
+    // 边沿触发时, 未收发至 EAGAIN 即停止的端点不会再收到通知, 由就绪链表在下一轮继续处理:
+    // 本次事件的预算用完, 或暂停接收/等待发送的端点恢复时加入; 水平触发时忽略
+    void setReady(Endpoint_t *pe, uint32_t events);
+    void processReadyList();
+    // 本次事件的收发预算已用完时加入就绪链表, 返回 true
+    inline bool budgetExhausted(Endpoint_t *pe, uint32_t events) { return mIoBudget <= 0 && (setReady(pe, events), true); }
 
     static void setStatus(Tunnel_t *pt, TunnelState_t stat);
 
     Tunnel_t *getTunnel();
-    void acceptClient(time_t curTime, Endpoint_t *pe);
-    bool connect(time_t curTime, Endpoint_t *pse, Tunnel_t *pt);
-
-    void onRead(time_t curTime, int events, Endpoint_t *pe);
-    void onWrite(time_t curTime, int events, Endpoint_t *pe);
+    // soc: 由 io_uring multishot accept 接受的连接, -1 时由 accept(2) 接受
+    void acceptClient(Endpoint_t *pse, int soc = -1);
+    bool connect(Endpoint_t *pse, Tunnel_t *pt);
+
+    void onRead(int events, Endpoint_t *pe);
+    void onWrite(int events, Endpoint_t *pe);
+    bool bufferRead(Endpoint_t *pe);
+    // 对端发送链表为空时直接发送, 返回发出的字节数; 发送失败时关闭 pe
+    int writeThrough(Endpoint_t *pe, const char *buf, int size);
+    bool bufferWrite(Endpoint_t *pe);
+    bool spliceRead(Endpoint_t *pe);
+    bool spliceWrite(Endpoint_t *pe);
+    bool ringRead(Endpoint_t *pe);
+    bool ringWrite(Endpoint_t *pe);
+
+    // io_uring 完成模式 (TUNMODE_URING): 接收至缓冲区环中的缓冲区, 经同一缓冲区发往对端,
+    // 发送完毕后才继续接收 (链接的 send -> recv), 每个方向至多占用一个缓冲区
+    bool initRecvBufs();
+    void releaseRecvBufs();
+    void doCompletion(const UringPoller::Completion_t &c);
+    void onConnected(Endpoint_t *pe, int res);
+    void onRecv(const UringPoller::Completion_t &c);
+    void onSend(const UringPoller::Completion_t &c);
+    inline void provideRecvBuf(uint32_t bid) { mpUring->provide(bid, mRecvBufs[bid]->buffer, URING_BUF_SIZE), ++mFreeRecvBufs; }
+    // 缓冲区环为空 (-ENOBUFS) 的读端, 缓冲区归还后按顺序恢复接收
+    void resumeStarvedReaders();
+
+    bool loadServiceSetting(const Forward &forward, ServiceSetting_t &setting);
+    bool createPipe(Endpoint_t *pe);
+    static void closePipe(Endpoint_t *pe);
+    bool createRing(Endpoint_t *pe);
+    void closeRing(Endpoint_t *pe);
+    void releaseRingPool();
 
     inline void addToCloseList(Tunnel_t *pt) { mPostProcessList.insert(pt); };
     inline void addToCloseList(Endpoint_t *pe) { addToCloseList((Tunnel_t *)pe->container); }
     void closeTunnel(Tunnel_t *pt);
     void releaseEndpointBuffer(Endpoint_t *pe);
+    void defragment();
 
-    inline void addToTimer(utils::TimerList &timer, time_t curTime, Tunnel_t *pt)
-    {
-        timer.push_back(curTime, &pt->timerEntity);
-    }
-    inline void removeFromTimer(utils::TimerList &timer, Tunnel_t *pt)
-    {
-        timer.erase(&pt->timerEntity);
-    }
-    inline void refreshTimer(utils::TimerList &timer, time_t curTime, Tunnel_t *pt)
-    {
-        timer.refresh(curTime, &pt->timerEntity);
-    }
-    void refreshTimer(time_t curTime, Tunnel_t *pt);
-    inline void switchTimer(utils::TimerList &src, utils::TimerList &dst, time_t curTime, Tunnel_t *pt)
-    {
-        src.erase(&pt->timerEntity);
-        dst.push_back(curTime, &pt->timerEntity);
-    }
+    // per-forward buffer budget: bytes the forward may still cut from the buffer, and accounting of cut blocks
+    int64_t budgetQuota(Endpoint_t *pe);
+    void chargeBudget(Endpoint_t *pe, int64_t size);
+
+    // readers starved by buffer exhaustion, resumed in FIFO order when buffer is released
+    void parkReader(Endpoint_t *pe);
+    void unparkReader(Endpoint_t *pe);
+    void resumeParkedReaders();
+
+    // tunnel 按状态使用不同的超时时长 (ms), 状态切换时重新放入时间轮; 收发数据时只记录活跃时间
+    inline void addToTimer(uint32_t timeout, Tunnel_t *pt) { mTimerWheel.add(utils::Clock::ms(), timeout, &pt->timerEntity); }
+    inline void removeFromTimer(Tunnel_t *pt) { mTimerWheel.erase(&pt->timerEntity); }
+    inline void refreshTimer(Tunnel_t *pt) { mTimerWheel.refresh(utils::Clock::ms(), &pt->timerEntity); }
 
     static const bool StateMaine[TUNNEL_STATE_COUNT][TUNNEL_STATE_COUNT];
 
-    int mEpollfd;
+    uint32_t mReactorId;
+    std::list<TcpForwardService *> mReactorList; // reactors 1..n-1, owned by reactor 0
+
+    Poller *mpPoller;
+    UringPoller *mpUring; // mpPoller of io_uring backend, otherwise nullptr
+    Endpoint_t *mpNotifier; // eventfd, wakes the event loop up on stop
+    std::vector<epoll_event> mEvents;
+    std::vector<uint64_t> mReadyList; // Endpoint::handle() of endpoints with readyEvents
+    // bytes the endpoint being handled may still receive, or send, in this event
+    int64_t mIoBudget;
+    bool mBusy; // events handled since the last housekeeping
     volatile bool mStopFlag;
     std::thread mMainRoutineThread;
 
     std::list<std::shared_ptr<Forward>> mForwardList;
     Service::Setting_t mSetting;
     buffer::DynamicBuffer *mpDynamicBuffer;
+    std::map<int64_t, std::list<buffer::RingBuffer *>> mRingPool; // idle RingBuffers by capacity
     std::set<Tunnel_t *> mPostProcessList;
     std::set<Tunnel_t *> mCloseList;
+    Endpoint_t *mpParkedHead;
+    Endpoint_t *mpParkedTail;
+    std::vector<buffer::DynamicBuffer::BufBlk_t *> mRecvBufs; // buffers of the provided buffer ring, by bid
+    uint32_t mFreeRecvBufs;                                   // buffers in the provided buffer ring
+    std::vector<uint64_t> mStarvedList;                       // Endpoint::handle() of readers starved by -ENOBUFS
     TargetManager mTargetManager;
 
     std::map<sockaddr_in, Endpoint_t *, Utils::Comparator_t> mAddr2ServiceEndpoint;
+    std::list<ServiceSetting_t> mServiceSettingList; // referred by service endpoint's container
+    std::map<std::string, Budget_t> mBudgets;        // by forward's interface:service
+    std::vector<Budget_t *> mBudgetTable;            // by budget id, [0]: nullptr for tunnels without budget
+    int64_t mReservedLimit;                          // sum of budgets' limit
+    int64_t mReservedUsed;                           // sum of budgets' used whose limit is not 0
     std::set<Tunnel_t *> mTunnelList;
 
-    utils::TimerList mConnectTimer;
-    utils::TimerList mSessionTimer;
-    utils::TimerList mReleaseTimer;
+    utils::TimingWheel mTimerWheel; // timeouts of all tunnels
+    uint64_t mLastScanTime; // ms, of the last housekeeping
 
     // for statistic
+    time_t mLastStatisticTime;
     volatile float mUp;
     volatile float mDown;
     volatile float mTotalUp;
     volatile float mTotalDown;
+    std::atomic<uint64_t> mCtlCount; // kernel registrations submitted by this reactor's poller
+    uint64_t mLastCtlCount;          // sum of all reactors' mCtlCount at the last statistic
 };
 
 } // namespace link
@@ -12,6 +12,7 @@
 #define __MAPPER_LINK_TUNNEL_H__
 
 #include "type.h"
+#include "../utils/slabPool.h"
 
 namespace mapper
 {
@@ -20,9 +21,7 @@ namespace link
 
 class Tunnel
 {
-    static const uint32_t BUFFER_SIZE = 1 << 10;
-    static const uint32_t RELEASE_THRESHOLD = BUFFER_SIZE + 1 << 8;
-    static const uint32_t BATCH_ALLOC_COUNT = 1 << 7;
+    typedef utils::SlabPool<Tunnel_t, TunnelCold_t> Pool;
 
 protected:
     Tunnel() = default;
@@ -33,13 +32,10 @@ public:
     static Tunnel_t *getTunnel();
     static void releaseTunnel(Tunnel_t *pt);
 
-protected:
-    static void batchAlloc(const uint32_t count);
-
-    static uint32_t gFreeCount;
-    static uint32_t gInUseCount;
-
-    static std::list<Tunnel_t *> gFreeList;
+    // 对象池按线程划分, 预先分配当前线程的 count 个对象
+    static inline bool prewarm(uint32_t count) { return Pool::prewarm(count); }
+    // 建立/关闭连接时才访问的字段
+    static inline TunnelCold_t *cold(const Tunnel_t *pt) { return Pool::cold(pt); }
 };
 
 } // namespace link
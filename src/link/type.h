@@ -11,16 +11,17 @@
 #ifndef __MAPPER_LINK_TYPE_H__
 #define __MAPPER_LINK_TYPE_H__
 
+#include <stddef.h>
 #include <stdint.h>
 #include <netinet/in.h>
-#include "../utils/timerList.h"
+#include "../utils/timingWheel.h"
 
 namespace mapper
 {
 namespace link
 {
 
-enum Type_t
+enum Type_t : uint8_t
 {
     TYPE_INVALID = 0,
     TYPE_SERVICE,
@@ -34,14 +35,14 @@ enum Protocol_t
     PROTOCOL_TCP,
 };
 
-enum Direction_t
+enum Direction_t : uint8_t
 {
     TO_UNKNOWN = 0,
     TO_NORTH,
     TO_SOUTH
 };
 
-enum TunnelState_t
+enum TunnelState_t : uint8_t
 {
     TUNSTAT_CLOSED = 0,
     TUNSTAT_INITIALIZED,
@@ -51,6 +52,14 @@ enum TunnelState_t
     TUNNEL_STATE_COUNT
 };
 
+enum TunnelMode_t : uint8_t
+{
+    TUNMODE_BUFFER = 0, // relay through DynamicBuffer
+    TUNMODE_SPLICE,     // zero-copy relay: socket -> pipe -> socket by splice(2)
+    TUNMODE_RING,       // relay through a per-endpoint mirrored RingBuffer
+    TUNMODE_URING       // buffer mode on io_uring backend: linked send -> recv requests through the provided buffer ring
+};
+
 struct Connection_t
 {
     Protocol_t protocol;
@@ -81,71 +90,129 @@ struct Connection_t
     }
 };
 
+// 收发路径 (doTunnelSoc -> onRead/onWrite) 访问的字段, 恰好占用一个 cache line, 在对象池中紧密排列;
+// 地址、链表指针等建立/关闭连接时才访问的字段存放于对象池的冷数据表中, 见 EndpointCold_t
 struct Endpoint_t
 {
+    int soc;
+    uint32_t pollEvents; // registered events (epoll backend: including pending modification)
+    bool valid;
+    bool bufferFull;
+    uint8_t pollState; // io_uring backend: poll request armed/fired or completion requests issued; epoll backend: modification pending
     Direction_t direction;
     Type_t type;
-    bool valid;
+    // edge trigger: events (EPOLLIN | EPOLLOUT) to go on with, while queued on the service's ready list
+    uint8_t readyEvents;
 
-    int soc;
-    Connection_t conn;
-
-    Endpoint_t *prev;
-    Endpoint_t *next;
     Endpoint_t *peer;
-    void *service;
     void *container;
     void *sendListHead;
     void *sendListTail;
 
     int64_t totalBufSize;
-    bool bufferFull;
+    // backpressure: bufferFull is set when totalBufSize reaches highWatermark,
+    // and cleared when it drains to lowWatermark; always > lowWatermark
+    uint32_t highWatermark;
+    uint32_t lowWatermark;
 
     Endpoint_t(){};
-    inline void init(Protocol_t protocol, Direction_t _direction, Type_t _type)
+    inline void init(Direction_t _direction, Type_t _type)
     {
+        soc = 0;
+        pollEvents = 0;
+        valid = true;
+        bufferFull = false;
+        pollState = 0;
         direction = _direction;
         type = _type;
-        valid = true;
-
-        soc = 0;
-        conn.init(protocol);
+        readyEvents = 0;
 
-        prev = nullptr;
-        next = nullptr;
         peer = nullptr;
-        service = nullptr;
         container = nullptr;
         sendListHead = nullptr;
         sendListTail = nullptr;
 
         totalBufSize = 0;
-        bufferFull = false;
+        highWatermark = 0;
+        lowWatermark = 0;
+    }
+};
+
+// Endpoint_t 的冷数据; ring / splice 模式每次收发多访问其中一个 cache line
+struct EndpointCold_t
+{
+    Connection_t conn;
+    // parked on the service's reader list (linked by prev/next) while the buffer is exhausted
+    bool parked;
+    Endpoint_t *prev;
+    Endpoint_t *next;
+    void *service;
+
+    // for ring mode: buffer::RingBuffer holding the data to be sent by this endpoint
+    void *ring;
+    // for splice mode: pipe holding the data to be sent by this endpoint
+    int pipe[2];
+    int64_t pipeSize;
+
+    inline void init(Protocol_t protocol)
+    {
+        conn.init(protocol);
+        parked = false;
+        prev = nullptr;
+        next = nullptr;
+        service = nullptr;
+
+        ring = nullptr;
+        pipe[0] = pipe[1] = 0;
+        pipeSize = 0;
     }
 };
 
+// timerEntity 须为首个成员 (时间轮中的 Entity_t 地址即 Tunnel_t 地址),
+// 其后为收发路径访问的字段, 与 timerEntity 同处一个 cache line; 其余字段见 TunnelCold_t
 struct Tunnel_t
 {
-    utils::TimerList::Entity_t  timerEntity;
+    utils::TimingWheel::Entity_t timerEntity;
+
+    TunnelState_t stat;
+    TunnelMode_t mode;
+    uint32_t budget; // tcp: id of the buffer budget of the forward the tunnel belongs to, 0: none
 
     Endpoint_t *north;
     Endpoint_t *south;
-    void *service;
-
-    TunnelState_t stat;
 
     inline void init()
     {
         timerEntity.init(this);
 
+        stat = TUNSTAT_CLOSED;
+        mode = TUNMODE_BUFFER;
+        budget = 0;
+
         north = nullptr;
         south = nullptr;
-        service = nullptr;
+    }
+};
 
-        stat = TUNSTAT_CLOSED;
+// Tunnel_t 的冷数据
+struct TunnelCold_t
+{
+    void *service;
+    // udp: key of the tunnel in the flow table, Utils::addrKey of service address and client address
+    uint64_t serviceKey;
+    uint64_t clientKey;
+
+    inline void init()
+    {
+        service = nullptr;
+        serviceKey = 0;
+        clientKey = 0;
     }
 };
 
+static_assert(sizeof(Endpoint_t) == 64, "Endpoint_t does not fit a cache line");
+static_assert(sizeof(Tunnel_t) == 64, "Tunnel_t does not fit a cache line");
+
 } // namespace link
 } // namespace mapper
 
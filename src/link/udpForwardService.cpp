@@ -1,7 +1,10 @@
 #include "udpForwardService.h"
 #include <execinfo.h>
 #include <time.h>
+#include <unistd.h>
 #include <sys/epoll.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
 #include <sstream>
 #include <rapidjson/document.h>
 #include <spdlog/spdlog.h>
@@ -26,25 +29,38 @@ namespace link
 {
 
 const uint32_t UdpForwardService::EPOLL_THREAD_RETRY_INTERVAL = 7;
-const uint32_t UdpForwardService::EPOLL_MAX_EVENTS = 8;
-const uint32_t UdpForwardService::INTERVAL_EPOLL_WAIT_TIME = 50;
-const uint32_t UdpForwardService::PREALLOC_RECV_BUFFER_SIZE = 1 << 16;
+const uint32_t UdpForwardService::PREALLOC_RECV_BUFFER_SIZE = 1 << 16; // 可容纳任意 udp 数据包
+const uint32_t UdpForwardService::MMSG_BATCH_SIZE = 16;
+
+// control message of UDP_GRO (int) / UDP_SEGMENT (uint16_t)
+static const size_t SEG_CMSG_SPACE = CMSG_SPACE(sizeof(int));
+const uint32_t UdpForwardService::PKT_RING_SIZE = 1 << 16;
 
 UdpForwardService::UdpForwardService()
     : Service("udpFwd"),
-      mServiceEpollfd(0),
-      mForwardEpollfd(0),
+      mpServicePoller(nullptr),
+      mpForwardPoller(nullptr),
       mStopFlag(false),
+      mToNorthPktRing(PKT_RING_SIZE),
+      mToSouthPktRing(PKT_RING_SIZE),
+      mpToNorthNotifier(nullptr),
+      mpToSouthNotifier(nullptr),
+      mNorthBusy(false),
+      mSouthBusy(false),
       mUp(0),
       mDown(0),
       mTotalUp(0),
-      mTotalDown(0)
+      mTotalDown(0),
+      mCtlCount(0),
+      mLastCtlCount(0)
 {
 }
 
 UdpForwardService::~UdpForwardService()
 {
     closeTunnels();
+    releasePkts();
+    closeNotifiers();
 
     // release buffer
     mpToNorthDynamicBuffer && (DynamicBuffer::releaseDynamicBuffer(mpToNorthDynamicBuffer), mpToNorthDynamicBuffer = nullptr);
@@ -68,15 +84,29 @@ bool UdpForwardService::init(list<shared_ptr<Forward>> &forwardList, Setting_t &
 
     // create buffer
     spdlog::trace("[UdpForwardService::init] create buffer");
-    mpToNorthDynamicBuffer = buffer::DynamicBuffer::allocDynamicBuffer(setting.bufferSize);
-    // mpToSouthDynamicBuffer = buffer::DynamicBuffer::allocDynamicBuffer(setting.bufferSize);
-    mpToSouthDynamicBuffer = mpToNorthDynamicBuffer;
+    // 每个方向各用一半: south 线程独占 to north 缓存的分配, north 线程独占 to south 缓存的分配
+    mpToNorthDynamicBuffer = buffer::DynamicBuffer::allocDynamicBuffer(setting.bufferSize / 2, setting.bufferPolicy, setting.bufferHugePage);
+    mpToSouthDynamicBuffer = buffer::DynamicBuffer::allocDynamicBuffer(setting.bufferSize / 2, setting.bufferPolicy, setting.bufferHugePage);
     if (!mpToNorthDynamicBuffer || !mpToSouthDynamicBuffer)
     {
         spdlog::error("[UdpForwardService::init] alloc buffer fail");
         return false;
     }
 
+    // create receive buffers: one slot per packet of a recvmmsg batch
+    mSouthRecvBuffer.resize(MMSG_BATCH_SIZE * PREALLOC_RECV_BUFFER_SIZE);
+    mNorthRecvBuffer.resize(MMSG_BATCH_SIZE * PREALLOC_RECV_BUFFER_SIZE);
+    mSouthEvents.resize(mSetting.eventBatch);
+    mNorthEvents.resize(mSetting.eventBatch);
+
+    // create notifiers of packet rings
+    spdlog::trace("[UdpForwardService::init] create notifiers");
+    if (!createNotifiers())
+    {
+        spdlog::error("[UdpForwardService::init] create notifiers fail");
+        return false;
+    }
+
     // start thread
     spdlog::trace("[UdpForwardService::init] start thread");
     mNorthThread = thread(&UdpForwardService::northThread, this);
@@ -96,6 +126,10 @@ void UdpForwardService::stop()
     // set stop flag
     spdlog::trace("[UdpForwardService::stop] set stop flag");
     mStopFlag = true;
+
+    // wake both threads up
+    mpToNorthNotifier && (notify(mpToNorthNotifier), true);
+    mpToSouthNotifier && (notify(mpToSouthNotifier), true);
 }
 
 void UdpForwardService::close()
@@ -104,9 +138,13 @@ void UdpForwardService::close()
 
     // stop thread
     spdlog::trace("[UdpForwardService::close] stop thread");
-    mStopFlag = true;
+    stop();
     join();
 
+    // release packets in rings and notifiers
+    releasePkts();
+    closeNotifiers();
+
     // release buffer
     spdlog::trace("[UdpForwardService::close] release buffer");
     if (mpToNorthDynamicBuffer)
@@ -133,6 +171,20 @@ string UdpForwardService::getStatistic(time_t curTime)
     ss << "u/d:" << Utils::toHumanStr(mUp / deltaTime) << "ps/" << Utils::toHumanStr(mDown / deltaTime)
        << "ps,tu/td:" << Utils::toHumanStr(mTotalUp) << "/" << Utils::toHumanStr(mTotalDown);
 
+    // epoll_ctl calls
+    uint64_t ctlCount = mCtlCount;
+    ss << ",ctl:" << (ctlCount - mLastCtlCount) / deltaTime << "ps";
+    mLastCtlCount = ctlCount;
+
+    // buffer statistic
+    DynamicBuffer::Statistic_t bufferStatistic{};
+    DynamicBuffer *buffers[2] = {mpToNorthDynamicBuffer, mpToSouthDynamicBuffer};
+    for (auto pBuffer : buffers)
+    {
+        pBuffer && (DynamicBuffer::accumulate(bufferStatistic, pBuffer->getStatistic()), true);
+    }
+    ss << "," << DynamicBuffer::dumpStatistic(bufferStatistic);
+
     return ss.str();
 }
 
@@ -140,12 +192,25 @@ void UdpForwardService::resetStatistic()
 {
     mUp = 0;
     mDown = 0;
+
+    mpToNorthDynamicBuffer && (mpToNorthDynamicBuffer->resetStatistic(), true);
+    mpToSouthDynamicBuffer && (mpToSouthDynamicBuffer->resetStatistic(), true);
 }
 
 void UdpForwardService::northThread()
 {
     spdlog::debug("[UdpForwardService::northThread] udp forward service thread start");
 
+    // north 线程为 to south 缓存的唯一分配者
+    mpToSouthDynamicBuffer->bindOwner(mSetting.bufferNuma);
+    Clock::update();
+
+    // tunnel 及其北向 endpoint 只在 north 线程中分配
+    if (!Tunnel::prewarm(mSetting.tunnelPrewarm) || !Endpoint::prewarm(mSetting.tunnelPrewarm))
+    {
+        spdlog::warn("[UdpForwardService::northThread] prewarm {} tunnels fail", mSetting.tunnelPrewarm);
+    }
+
     while (!mStopFlag)
     {
         // init env
@@ -162,30 +227,37 @@ void UdpForwardService::northThread()
         // main routine
         try
         {
-            time_t lastScanTime = 0;
-            time_t curTime;
+            uint64_t lastScanTime = 0;
 
             while (!mStopFlag)
             {
-                curTime = time(nullptr);
-
                 // append to north packet list
-                processToNorthPkts(curTime);
-
-                if (!doNorthEpoll(curTime, mForwardEpollfd))
+                processToNorthPkts();
+
+                // wait until the next timeout or housekeeping, or until woken up by the notifier;
+                // do not wait while there are tunnels to close
+                uint64_t deadline = mCloseList.empty()
+                                        ? min(mTimeoutTimer.nextExpire(),
+                                              housekeepingTime(lastScanTime, mNorthBusy, mSetting.bufferTrim))
+                                        : Clock::ms();
+                if (!doNorthEpoll(waitTimeout(Clock::ms(), deadline)))
                 {
                     spdlog::error("[UdpForwardService::northThread] do epoll fail.");
                     break;
                 }
 
+                // scan timeout
+                scanTimeout();
+
                 // post process
-                postProcess(curTime);
+                postProcess();
 
-                // scan timeout
-                if (lastScanTime < curTime)
+                if (Clock::ms() >= lastScanTime + HOUSEKEEPING_INTERVAL)
                 {
-                    scanTimeout(curTime);
-                    lastScanTime = curTime;
+                    mpToSouthDynamicBuffer->updateFragmentation();
+                    mSetting.bufferTrim && (mpToSouthDynamicBuffer->trim(Clock::seconds(), mSetting.bufferTrim), true);
+                    lastScanTime = Clock::ms();
+                    mNorthBusy = false;
                 }
             }
         }
@@ -228,6 +300,10 @@ void UdpForwardService::southThread()
 {
     spdlog::debug("[UdpForwardService::southThread] udp forward service thread start");
 
+    // south 线程为 to north 缓存的唯一分配者
+    mpToNorthDynamicBuffer->bindOwner(mSetting.bufferNuma);
+    Clock::update();
+
     while (!mStopFlag)
     {
         // init env
@@ -244,21 +320,29 @@ void UdpForwardService::southThread()
         // main routine
         try
         {
-            time_t lastScanTime = 0;
-            time_t curTime;
+            uint64_t lastScanTime = 0;
 
             while (!mStopFlag)
             {
-                curTime = time(nullptr);
-
                 // append to south packet list
-                processToSouthPkts(curTime);
+                processToSouthPkts();
 
-                if (!doSouthEpoll(curTime, mServiceEpollfd))
+                // wait until the next housekeeping, or until woken up by the notifier
+                uint64_t deadline = housekeepingTime(lastScanTime, mSouthBusy, mSetting.bufferTrim);
+                if (!doSouthEpoll(waitTimeout(Clock::ms(), deadline)))
                 {
                     spdlog::error("[UdpForwardService::southThread] do epoll fail.");
                     break;
                 }
+
+                // buffer statistic
+                if (Clock::ms() >= lastScanTime + HOUSEKEEPING_INTERVAL)
+                {
+                    mpToNorthDynamicBuffer->updateFragmentation();
+                    mSetting.bufferTrim && (mpToNorthDynamicBuffer->trim(Clock::seconds(), mSetting.bufferTrim), true);
+                    lastScanTime = Clock::ms();
+                    mSouthBusy = false;
+                }
             }
         }
         catch (const exception &e)
@@ -298,12 +382,18 @@ void UdpForwardService::southThread()
 
 bool UdpForwardService::initNorthEnv()
 {
-    // init forward epoll fd
-    spdlog::trace("[UdpForwardService::initNorthEnv] init forward epoll fd");
-    if ((mForwardEpollfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+    // init forward poller
+    spdlog::trace("[UdpForwardService::initNorthEnv] init forward poller");
+    if ((mpForwardPoller = Poller::create(mSetting.backend, &mCtlCount)) == nullptr)
+    {
+        spdlog::error("[UdpForwardService::initNorthEnv] Failed to create forward poller.");
+        return false;
+    }
+
+    // add notifier into poller
+    if (!epollAddEndpoint(mpForwardPoller, mpToNorthNotifier, true, false, false))
     {
-        spdlog::error("[UdpForwardService::initNorthEnv] Failed to create forward epoll fd. {} - {}",
-                      errno, strerror(errno));
+        spdlog::error("[UdpForwardService::initNorthEnv] add notifier into poller fail.");
         return false;
     }
 
@@ -312,12 +402,18 @@ bool UdpForwardService::initNorthEnv()
 
 bool UdpForwardService::initSouthEnv()
 {
-    // init service epoll fd
-    spdlog::trace("[UdpForwardService::initSouthEnv] init service epoll fd");
-    if ((mServiceEpollfd = epoll_create1(0)) < 0)
+    // init service poller
+    spdlog::trace("[UdpForwardService::initSouthEnv] init service poller");
+    if ((mpServicePoller = Poller::create(mSetting.backend, &mCtlCount)) == nullptr)
+    {
+        spdlog::error("[UdpForwardService::initSouthEnv] Failed to create service poller.");
+        return false;
+    }
+
+    // add notifier into poller
+    if (!epollAddEndpoint(mpServicePoller, mpToSouthNotifier, true, false, false))
     {
-        spdlog::error("[UdpForwardService::initSouthEnv] Failed to create service epoll fd. {} - {}",
-                      errno, strerror(errno));
+        spdlog::error("[UdpForwardService::initSouthEnv] add notifier into poller fail.");
         return false;
     }
 
@@ -337,11 +433,19 @@ bool UdpForwardService::initSouthEnv()
 
         // service 是否已经存在
         Endpoint_t *pe;
-        auto it = mAddr2ServiceEndpoint.find(sai);
-        if (it == mAddr2ServiceEndpoint.end())
+        auto ppe = mAddr2ServiceEndpoint.find(Utils::addrKey(sai));
+        if (ppe == nullptr)
         {
             // 新服务
 
+            // load service setting
+            ServiceSetting_t serviceSetting;
+            if (!loadServiceSetting(*forward, serviceSetting))
+            {
+                spdlog::error("[UdpForwardService::initSouthEnv] load setting of forward{} fail.", forward->toStr());
+                return false;
+            }
+
             // create service endpoint
             spdlog::trace("[UdpForwardService::initSouthEnv] create service endpoint");
             pe = Endpoint::getEndpoint(PROTOCOL_UDP, TO_SOUTH, TYPE_SERVICE);
@@ -350,14 +454,17 @@ bool UdpForwardService::initSouthEnv()
                 spdlog::error("[UdpForwardService::initSouthEnv] create service endpoint fail.");
                 return false;
             }
+            mServiceSettingList.push_back(serviceSetting);
+            pe->container = &mServiceSettingList.back();
 
             // create service soc
             spdlog::trace("[UdpForwardService::initSouthEnv] create service soc");
             pe->soc = Utils::createServiceSoc(PROTOCOL_UDP, &sai, sizeof(sockaddr_in));
             if (pe->soc > 0)
             {
-                pe->conn.localAddr = sai;
-                mAddr2ServiceEndpoint[sai] = pe;
+                Endpoint::cold(pe)->conn.localAddr = sai;
+                mAddr2ServiceEndpoint.insert(Utils::addrKey(sai), pe);
+                serviceSetting.offload && (enableGro(pe->soc), true);
             }
             else
             {
@@ -369,33 +476,32 @@ bool UdpForwardService::initSouthEnv()
 
             // add service endpoint into epoll driver
             spdlog::trace("[UdpForwardService::initSouthEnv] add service endpoint into epoll driver");
-            if (!epollAddEndpoint(mServiceEpollfd, pe, true, true, false))
+            if (!epollAddEndpoint(mpServicePoller, pe, true, true, false))
             {
                 spdlog::error("[UdpForwardService::init] add service endpoint into epoll driver fail.");
                 return false;
             }
 
             spdlog::trace("[UdpForwardService::initSouthEnv] create udp forward service: {}",
-                          Utils::dumpSockAddr(pe->conn.localAddr));
+                          Utils::dumpSockAddr(Endpoint::cold(pe)->conn.localAddr));
         }
         else
         {
-            pe = it->second;
+            pe = *ppe;
         }
         if (mTargetManager.addTarget(pe->soc,
                                      forward->targetHost.c_str(),
                                      forward->targetService.c_str(),
                                      PROTOCOL_UDP))
         {
-            mAddr2ServiceEndpoint[pe->conn.localAddr] = pe;
 #ifdef ENABLE_DETAIL_LOGS
             spdlog::debug("[UdpForwardService::initSouthEnv] set service endpoint by[{}]",
-                          Utils::dumpSockAddr(pe->conn.localAddr));
+                          Utils::dumpSockAddr(Endpoint::cold(pe)->conn.localAddr));
 #endif // ENABLE_DETAIL_LOGS
 
             spdlog::info("[UdpForwardService::initEnv] service[{}] add target: {} -> {}:{}",
                          pe->soc,
-                         Utils::dumpSockAddr(pe->conn.localAddr),
+                         Utils::dumpSockAddr(Endpoint::cold(pe)->conn.localAddr),
                          forward->targetHost, forward->targetService);
         }
         else
@@ -411,9 +517,12 @@ bool UdpForwardService::initSouthEnv()
 
 void UdpForwardService::closeNorthEnv()
 {
-    // close epoll fd
-    spdlog::trace("[UdpForwardService::closeNorthEnv] close forward epoll fd");
-    mForwardEpollfd && (::close(mForwardEpollfd), mForwardEpollfd = 0);
+    // remove notifier from poller
+    mpForwardPoller && (epollRemoveEndpoint(mpForwardPoller, mpToNorthNotifier), true);
+
+    // release poller
+    spdlog::trace("[UdpForwardService::closeNorthEnv] release forward poller");
+    mpForwardPoller && (Poller::release(mpForwardPoller), mpForwardPoller = nullptr);
 }
 
 void UdpForwardService::closeSouthEnv()
@@ -422,64 +531,76 @@ void UdpForwardService::closeSouthEnv()
     if (!mAddr2ServiceEndpoint.empty())
     {
         spdlog::trace("[UdpForwardService::closeSouthEnv] close udp forward services");
-        for (auto it : mAddr2ServiceEndpoint)
-        {
+        mAddr2ServiceEndpoint.forEach([&](const uint64_t &, Endpoint_t *pe) {
             spdlog::trace("[UdpForwardService::closeSouthEnv] close udp forward service: {}",
-                          Utils::dumpSockAddr(it.second->conn.localAddr));
+                          Utils::dumpSockAddr(Endpoint::cold(pe)->conn.localAddr));
 
-            if (it.second->soc)
+            if (pe->soc)
             {
                 // remove service socket from epoll
-                epollRemoveEndpoint(mServiceEpollfd, it.second);
+                epollRemoveEndpoint(mpServicePoller, pe);
 
                 // close socket
-                ::close(it.second->soc);
-                it.second->soc = 0;
+                ::close(pe->soc);
+                pe->soc = 0;
             }
             // release endpoint_t object
-            Endpoint::releaseEndpoint(it.second);
-        }
+            Endpoint::releaseEndpoint(pe);
+        });
         mAddr2ServiceEndpoint.clear();
     }
+    mServiceSettingList.clear();
 
     // clean target manager
     mTargetManager.clear();
 
-    // close epoll fd
-    spdlog::trace("[UdpForwardService::closeSouthEnv] close service epoll fd");
-    mServiceEpollfd && (::close(mServiceEpollfd), mServiceEpollfd = 0);
+    // remove notifier from poller
+    mpServicePoller && (epollRemoveEndpoint(mpServicePoller, mpToSouthNotifier), true);
+
+    // release poller
+    spdlog::trace("[UdpForwardService::closeSouthEnv] release service poller");
+    mpServicePoller && (Poller::release(mpServicePoller), mpServicePoller = nullptr);
 }
 
-bool UdpForwardService::doNorthEpoll(time_t curTime, int epollfd)
+bool UdpForwardService::doNorthEpoll(int timeout)
 {
-    struct epoll_event ee[EPOLL_MAX_EVENTS];
+    auto ee = mNorthEvents.data();
 
-    int nRet = epoll_wait(epollfd, ee, EPOLL_MAX_EVENTS, INTERVAL_EPOLL_WAIT_TIME);
+    int nRet = mpForwardPoller->wait(ee, mNorthEvents.size(), timeout);
+    Clock::update();
     if (nRet > 0)
     {
+        mNorthBusy = true;
         for (int i = 0; i < nRet; ++i)
         {
             link::Endpoint_t *pe = (link::Endpoint_t *)ee[i].data.ptr;
 
+            if (pe == mpToNorthNotifier)
+            {
+                // 有新的数据包, 于下一轮 processToNorthPkts() 中处理
+                clearNotify(pe);
+                continue;
+            }
+
             if (ee[i].events & (EPOLLOUT | EPOLLIN))
             {
                 // Write
                 if (ee[i].events & EPOLLOUT)
                 {
-                    northWrite(curTime, pe);
+                    northWrite(pe);
                 }
 
                 // Read
                 if (ee[i].events & EPOLLIN)
                 {
-                    northRead(curTime, pe);
+                    northRead(pe);
                 }
             }
             else
             {
                 spdlog::error("[UdpForwardService::doNorthEpoll] "
                               "endpoint[{}]: with error event: {}",
-                              ee[i].events);
+                              pe->soc, (uint32_t)ee[i].events);
                 addToCloseList(pe);
             }
         }
@@ -497,28 +618,37 @@ bool UdpForwardService::doNorthEpoll(time_t curTime, int epollfd)
     return true;
 }
 
-bool UdpForwardService::doSouthEpoll(time_t curTime, int epollfd)
+bool UdpForwardService::doSouthEpoll(int timeout)
 {
-    struct epoll_event ee[EPOLL_MAX_EVENTS];
+    auto ee = mSouthEvents.data();
 
-    int nRet = epoll_wait(epollfd, ee, EPOLL_MAX_EVENTS, INTERVAL_EPOLL_WAIT_TIME);
+    int nRet = mpServicePoller->wait(ee, mSouthEvents.size(), timeout);
+    Clock::update();
     if (nRet > 0)
     {
+        mSouthBusy = true;
         for (int i = 0; i < nRet; ++i)
         {
             link::Endpoint_t *pse = (link::Endpoint_t *)ee[i].data.ptr;
+
+            if (pse == mpToSouthNotifier)
+            {
+                // 有新的数据包, 于下一轮 processToSouthPkts() 中处理
+                clearNotify(pse);
+                continue;
+            }
             assert(pse->type == TYPE_SERVICE && pse->direction == TO_SOUTH);
 
             // Write
             if (ee[i].events & EPOLLOUT)
             {
-                southWrite(curTime, pse);
+                southWrite(pse);
             }
 
             // Read
             if (ee[i].events & EPOLLIN)
             {
-                southRead(curTime, pse);
+                southRead(pse);
             }
         }
     }
@@ -535,34 +665,29 @@ bool UdpForwardService::doSouthEpoll(time_t curTime, int epollfd)
     return true;
 }
 
-void UdpForwardService::postProcess(time_t curTime)
+void UdpForwardService::postProcess()
 {
     // clean useless tunnels
     closeTunnels();
 }
 
-void UdpForwardService::scanTimeout(time_t curTime)
+void UdpForwardService::scanTimeout()
 {
-    // TODO: nothin in timeout timer
-
-    time_t timeoutTime = curTime - mSetting.udpTimeout;
-    list<TimerList::Entity_t *> timeoutList;
-    mTimeoutTimer.getTimeoutList(timeoutTime, timeoutList);
-    for (auto entity : timeoutList)
-    {
+    mTimeoutTimer.expire(Clock::ms(), [this](TimingWheel::Entity_t *entity) {
         auto pt = (Tunnel_t *)entity;
         spdlog::trace("[UdpForwardService::scanTimeout] tunnel[{}] timeout", pt->north->soc);
         addToCloseList(pt);
-    }
+    });
 }
 
-Tunnel_t *UdpForwardService::getTunnel(time_t curTime, Endpoint_t *pse, sockaddr_in *southRemoteAddr)
+Tunnel_t *UdpForwardService::getTunnel(Endpoint_t *pse, sockaddr_in *southRemoteAddr)
 {
     // 从已缓存 tunnel 中查找
-    auto it = mAddr2Tunnel.find(*southRemoteAddr);
-    if (it != mAddr2Tunnel.end())
+    FlowKey_t flowKey = {Utils::addrKey(Endpoint::cold(pse)->conn.localAddr), Utils::addrKey(*southRemoteAddr)};
+    auto ppt = mFlow2Tunnel.find(flowKey);
+    if (ppt)
     {
-        return it->second;
+        return *ppt;
     }
 
     // create north endpoint
@@ -574,7 +699,7 @@ Tunnel_t *UdpForwardService::getTunnel(time_t curTime, Endpoint_t *pse, sockaddr
     }
     else
     {
-        north->service = this;
+        Endpoint::cold(north)->service = this;
         north->peer = pse;
 
         // create to north socket
@@ -585,6 +710,7 @@ Tunnel_t *UdpForwardService::getTunnel(time_t curTime, Endpoint_t *pse, sockaddr
             Endpoint::releaseEndpoint(north);
             return nullptr;
         }
+        ((ServiceSetting_t *)pse->container)->offload && (enableGro(north->soc), true);
         // spdlog::debug("[UdpForwardService::getTunnel] create north socket[{}].", north->soc);
 
         // connect to host
@@ -598,14 +724,14 @@ Tunnel_t *UdpForwardService::getTunnel(time_t curTime, Endpoint_t *pse, sockaddr
                 else if (connect(north->soc, (const sockaddr *)addr, sizeof(sockaddr_in)) < 0)
                 {
                     // report fail
-                    mTargetManager.failReport(curTime, addr);
+                    mTargetManager.failReport(pse->soc, addr);
                     spdlog::error("[UdpForwardService::getTunnel] connect fail. {} - {}",
                                   errno, strerror(errno));
                     return false;
                 }
 
                 // add into epoll driver
-                if (!epollAddEndpoint(mForwardEpollfd, north, true, true, false))
+                if (!epollAddEndpoint(mpForwardPoller, north, true, true, false))
                 {
                     spdlog::error("[UdpForwardService::getTunnel] add endpoint[{}] into epoll fail.", north->soc);
                     return false;
@@ -615,8 +741,8 @@ Tunnel_t *UdpForwardService::getTunnel(time_t curTime, Endpoint_t *pse, sockaddr
             }())
         {
             // save client's ip-port and target's ip-port
-            north->conn.localAddr = *southRemoteAddr;
-            north->conn.remoteAddr = *addr;
+            Endpoint::cold(north)->conn.localAddr = *southRemoteAddr;
+            Endpoint::cold(north)->conn.remoteAddr = *addr;
         }
         else
         {
@@ -639,37 +765,126 @@ Tunnel_t *UdpForwardService::getTunnel(time_t curTime, Endpoint_t *pse, sockaddr
     // bind tunnel and endpoints
     pt->north = north;
     pt->south = pse;
+    Tunnel::cold(pt)->serviceKey = flowKey.service;
+    Tunnel::cold(pt)->clientKey = flowKey.client;
     north->container = pt;
 
     // put into map
     // spdlog::trace("[UdpForwardService::getTunnel] put addr[{}] into map",
     //               Utils::dumpSockAddr(southRemoteAddr));
-    mAddr2Tunnel[*southRemoteAddr] = pt;
-    mSoc2Tunnel[north->soc] = pt;
+    mFlow2Tunnel.insert(flowKey, pt);
 
     // add to timer
-    mTimeoutTimer.push_back(curTime, &pt->timerEntity);
+    mTimeoutTimer.add(Clock::ms(), mSetting.udpTimeout, &pt->timerEntity);
 
     spdlog::debug("[UdpForwardService::getTunnel] create tunnel[{}]: {}=>{}=>{}",
                   north->soc,
                   Utils::dumpSockAddr(southRemoteAddr),
-                  Utils::dumpSockAddr(pse->conn.localAddr),
-                  Utils::dumpSockAddr(north->conn.remoteAddr));
+                  Utils::dumpSockAddr(Endpoint::cold(pse)->conn.localAddr),
+                  Utils::dumpSockAddr(Endpoint::cold(north)->conn.remoteAddr));
 
     return pt;
 }
 
-void UdpForwardService::southRead(time_t curTime, Endpoint_t *pse)
+void UdpForwardService::prepareRecvMsgs(mmsghdr *msgs, iovec *iovs, sockaddr_in *addrs, char *buffer, char *ctrls)
 {
-    socklen_t addrLen = sizeof(sockaddr_in);
-    list<DynamicBuffer::BufBlk_t *> recvList;
+    for (uint32_t i = 0; i < MMSG_BATCH_SIZE; ++i)
+    {
+        iovs[i].iov_base = buffer + i * PREALLOC_RECV_BUFFER_SIZE;
+        iovs[i].iov_len = PREALLOC_RECV_BUFFER_SIZE;
+
+        msgs[i].msg_hdr.msg_name = addrs ? &addrs[i] : nullptr;
+        msgs[i].msg_hdr.msg_namelen = addrs ? sizeof(sockaddr_in) : 0;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_control = ctrls + i * SEG_CMSG_SPACE;
+        msgs[i].msg_hdr.msg_controllen = SEG_CMSG_SPACE;
+        msgs[i].msg_hdr.msg_flags = 0;
+        msgs[i].msg_len = 0;
+    }
+}
 
-    while (true)
+uint32_t UdpForwardService::getSegSize(mmsghdr *msg)
+{
+    // 开启 UDP_GRO 的 socket 上, 合并后的数据包附带各数据包的大小
+    for (auto cmsg = CMSG_FIRSTHDR(&msg->msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&msg->msg_hdr, cmsg))
     {
+        if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO)
+        {
+            int segSize = *(int *)CMSG_DATA(cmsg);
+            return (uint32_t)segSize < msg->msg_len ? segSize : 0;
+        }
+    }
 
-        // detect udp packet length
-        int pktLen = recv(pse->soc, NULL, 0, MSG_PEEK | MSG_TRUNC);
-        if (pktLen < 0)
+    return 0;
+}
+
+void UdpForwardService::setSegSize(mmsghdr *msg, char *ctrl, uint32_t segSize)
+{
+    if (segSize == 0)
+    {
+        msg->msg_hdr.msg_control = nullptr;
+        msg->msg_hdr.msg_controllen = 0;
+        return;
+    }
+
+    // 由内核按 segSize 将数据包拆分发送 (UDP_SEGMENT)
+    msg->msg_hdr.msg_control = ctrl;
+    msg->msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+    auto cmsg = CMSG_FIRSTHDR(&msg->msg_hdr);
+    cmsg->cmsg_level = IPPROTO_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    *(uint16_t *)CMSG_DATA(cmsg) = segSize;
+}
+
+bool UdpForwardService::loadServiceSetting(const Forward &forward, ServiceSetting_t &setting)
+{
+    // offload: on | off
+    auto offload = forward.getOption("offload", "off");
+    if (offload == "on")
+    {
+        setting.offload = true;
+    }
+    else if (offload == "off")
+    {
+        setting.offload = false;
+    }
+    else
+    {
+        spdlog::error("[UdpForwardService::loadServiceSetting] unsupported offload: {}", offload);
+        return false;
+    }
+
+    return true;
+}
+
+void UdpForwardService::enableGro(int soc)
+{
+    int on = 1;
+    if (setsockopt(soc, IPPROTO_UDP, UDP_GRO, &on, sizeof(on)))
+    {
+        // 内核不支持时退回逐个接收
+        spdlog::warn("[UdpForwardService::enableGro] soc[{}] enable UDP_GRO fail. {} - {}",
+                     soc, errno, strerror(errno));
+    }
+}
+
+void UdpForwardService::southRead(Endpoint_t *pse)
+{
+    auto &serviceAddr = Endpoint::cold(pse)->conn.localAddr;
+    mmsghdr msgs[MMSG_BATCH_SIZE];
+    iovec iovs[MMSG_BATCH_SIZE];
+    sockaddr_in addrs[MMSG_BATCH_SIZE];
+    alignas(cmsghdr) char ctrls[MMSG_BATCH_SIZE * SEG_CMSG_SPACE];
+
+    bool outOfBuffer = false;
+    while (!outOfBuffer)
+    {
+        // 一次接收一批数据包
+        prepareRecvMsgs(msgs, iovs, addrs, mSouthRecvBuffer.data(), ctrls);
+        int count = recvmmsg(pse->soc, msgs, MMSG_BATCH_SIZE, 0, nullptr);
+        if (count < 0)
         {
             if (errno == EAGAIN)
             {
@@ -690,62 +905,100 @@ void UdpForwardService::southRead(time_t curTime, Endpoint_t *pse)
                 break;
             }
         }
-        else if (pktLen == 0)
+
+        // get buffers of the whole batch
+        uint64_t sizes[MMSG_BATCH_SIZE];
+        int indexes[MMSG_BATCH_SIZE];
+        uint32_t pkts = 0;
+        for (int i = 0; i < count; ++i)
         {
-            spdlog::trace("[UdpForwardService::southRead] skip empty udp packet.");
-            continue;
+            if (msgs[i].msg_len == 0)
+            {
+                spdlog::trace("[UdpForwardService::southRead] skip empty udp packet.");
+                continue;
+            }
+            indexes[pkts] = i;
+            sizes[pkts++] = msgs[i].msg_len;
         }
-
-        // get buffer
-        auto pBufBlk = mpToNorthDynamicBuffer->getBufBlk(pktLen);
-        if (pBufBlk == nullptr)
+        DynamicBuffer::BufBlk_t *pBufBlks[MMSG_BATCH_SIZE];
+        uint32_t allocated = mpToNorthDynamicBuffer->getBufBlks(sizes, pkts, pBufBlks);
+        if (allocated < pkts)
         {
             // out of buffer
-            spdlog::trace("[UdpForwardService::southRead] out of buffer, drop packet");
-            recv(pse->soc, NULL, 0, 0);
-            break;
+            spdlog::trace("[UdpForwardService::southRead] out of buffer, drop {} packets", pkts - allocated);
+            outOfBuffer = true;
         }
 
-        // receive buffer
-        recvfrom(pse->soc, pBufBlk->buffer, pktLen, 0, (sockaddr *)&pBufBlk->srcAddr, &addrLen);
-        pBufBlk->dstAddr = pse->conn.localAddr;
-        recvList.push_back(pBufBlk);
+        for (uint32_t j = 0; j < allocated; ++j)
+        {
+            int i = indexes[j];
+            uint32_t pktLen = msgs[i].msg_len;
+            auto pBufBlk = pBufBlks[j];
+
+            memcpy(pBufBlk->buffer, iovs[i].iov_base, pktLen);
+            pBufBlk->segSize = getSegSize(&msgs[i]);
+            pBufBlk->srcAddr = addrs[i];
+            pBufBlk->dstAddr = serviceAddr;
+            pBufBlk->tag = Endpoint::handle(pse);
+            if (!mToNorthPktRing.push(pBufBlk))
+            {
+                // north thread falls behind, 释放本批余下的数据块
+                spdlog::trace("[UdpForwardService::southRead] packet ring is full, drop {} packets", allocated - j);
+                for (; j < allocated; ++j)
+                {
+                    mpToNorthDynamicBuffer->release(pBufBlks[j]);
+                }
+                outOfBuffer = true;
+                break;
+            }
 
-        // statistic
-        mUp += pktLen;
-        mTotalUp += pktLen;
-    }
+            // statistic
+            mUp += pktLen;
+            mTotalUp += pktLen;
+        }
 
-    // merge receive list
-    {
-        lock_guard<mutex> lg(mAccessMutex);
-        mToNorthPktList.splice(mToNorthPktList.end(), recvList);
+        if (count < (int)MMSG_BATCH_SIZE)
+        {
+            // 接收队列已空
+            break;
+        }
     }
+
+    // hand over to north thread
+    mToNorthPktRing.publish() && (notify(mpToNorthNotifier), true);
 }
 
-void UdpForwardService::southWrite(time_t curTime, Endpoint_t *pse)
+void UdpForwardService::southWrite(Endpoint_t *pse)
 {
     auto pkt = (DynamicBuffer::BufBlk_t *)pse->sendListHead;
     if (!pkt)
     {
         // stop write
-        epollResetEndpointMode(mServiceEpollfd, pse, true, false, false);
+        epollResetEndpointMode(mpServicePoller, pse, true, false, false);
         return;
     }
 
+    mmsghdr msgs[MMSG_BATCH_SIZE];
+    iovec iovs[MMSG_BATCH_SIZE];
+    alignas(cmsghdr) char ctrls[MMSG_BATCH_SIZE * SEG_CMSG_SPACE];
     while (pkt)
     {
-        auto nRet = sendto(pse->soc,
-                           pkt->buffer,
-                           pkt->dataSize,
-                           0,
-                           (sockaddr *)&pkt->dstAddr,
-                           sizeof(sockaddr_in));
-        if (nRet > 0)
+        // 将发送链表中的数据包汇集起来, 一次发送
+        uint32_t count = 0;
+        for (auto p = pkt; p && count < MMSG_BATCH_SIZE; p = p->next, ++count)
         {
-            assert(nRet == pkt->dataSize);
+            iovs[count].iov_base = p->buffer;
+            iovs[count].iov_len = p->dataSize;
+            msgs[count].msg_hdr = msghdr{};
+            msgs[count].msg_hdr.msg_name = &p->dstAddr;
+            msgs[count].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            msgs[count].msg_hdr.msg_iov = &iovs[count];
+            msgs[count].msg_hdr.msg_iovlen = 1;
+            setSegSize(&msgs[count], ctrls + count * SEG_CMSG_SPACE, p->segSize);
         }
-        else if (nRet < 0)
+
+        int nRet = sendmmsg(pse->soc, msgs, count, 0);
+        if (nRet < 0)
         {
             if (errno == EAGAIN)
             {
@@ -758,29 +1011,28 @@ void UdpForwardService::southWrite(time_t curTime, Endpoint_t *pse)
                 spdlog::debug("[UdpForwardService::southWrite] broken by interrupt, try again.");
                 continue;
             }
-            else
-            {
-                spdlog::debug("[UdpForwardService::southWrite] send to [{}] fail: {}:[]",
-                              Utils::dumpSockAddr(pkt->dstAddr), errno, strerror(errno));
-            }
-        }
-        else
-        {
-            // send ZERO data, drop pkt
-            spdlog::warn("[UdpForwardService::southWrite] send ZERO data, drop pkt");
-        }
-
-        // release sent buffer
-        auto next = pkt->next;
-        pse->totalBufSize -= pkt->dataSize;
 
-        mpToSouthDynamicBuffer->release(pkt);
+            // 首个数据包发送失败, 丢弃之
+            spdlog::debug("[UdpForwardService::southWrite] send to [{}] fail: {}:[]",
+                          Utils::dumpSockAddr(pkt->dstAddr), errno, strerror(errno));
+            nRet = 1;
+            msgs[0].msg_len = 0;
+        }
 
-        pkt = next;
+        // release sent buffer: 已发送的数据包断开后一次归还
+        auto sent = pkt;
+        DynamicBuffer::BufBlk_t *last = nullptr;
+        for (int i = 0; i < nRet; ++i)
+        {
+            pse->totalBufSize -= pkt->dataSize;
+            last = pkt;
+            pkt = pkt->next;
 
-        // statistic
-        mDown += nRet;
-        mTotalDown += nRet;
+            // statistic
+            mDown += msgs[i].msg_len;
+            mTotalDown += msgs[i].msg_len;
+        }
+        last && (last->next = nullptr, mpToSouthDynamicBuffer->releaseList(sent), true);
     }
 
     if (pkt)
@@ -797,7 +1049,7 @@ void UdpForwardService::southWrite(time_t curTime, Endpoint_t *pse)
     }
 }
 
-void UdpForwardService::northRead(time_t curTime, Endpoint_t *pe)
+void UdpForwardService::northRead(Endpoint_t *pe)
 {
     if (!pe->valid)
     {
@@ -805,16 +1057,22 @@ void UdpForwardService::northRead(time_t curTime, Endpoint_t *pe)
         return;
     }
 
-    list<DynamicBuffer::BufBlk_t *> recvList;
-    socklen_t addrLen = sizeof(sockaddr_in);
-
-    while (true)
+    auto pt = (Tunnel_t *)pe->container;
+    auto &remoteAddr = Endpoint::cold(pe)->conn.remoteAddr;
+    auto &serviceAddr = Endpoint::cold(pe->peer)->conn.localAddr; // service's ip-port
+    auto &clientAddr = Endpoint::cold(pe)->conn.localAddr;        // south(client)'s ip-port
+    mmsghdr msgs[MMSG_BATCH_SIZE];
+    iovec iovs[MMSG_BATCH_SIZE];
+    sockaddr_in addrs[MMSG_BATCH_SIZE];
+    alignas(cmsghdr) char ctrls[MMSG_BATCH_SIZE * SEG_CMSG_SPACE];
+
+    bool outOfBuffer = false;
+    while (!outOfBuffer)
     {
-
-        // detect udp packet length
-        int pktLen = recv(pe->soc, NULL, 0, MSG_PEEK | MSG_TRUNC);
-
-        if (pktLen < 0)
+        // 一次接收一批数据包
+        prepareRecvMsgs(msgs, iovs, addrs, mNorthRecvBuffer.data(), ctrls);
+        int count = recvmmsg(pe->soc, msgs, MMSG_BATCH_SIZE, 0, nullptr);
+        if (count < 0)
         {
             if (errno == EAGAIN)
             {
@@ -835,51 +1093,76 @@ void UdpForwardService::northRead(time_t curTime, Endpoint_t *pe)
                 break;
             }
         }
-        else if (pktLen == 0)
+
+        // get buffers of the whole batch
+        uint64_t sizes[MMSG_BATCH_SIZE];
+        int indexes[MMSG_BATCH_SIZE];
+        uint32_t pkts = 0;
+        for (int i = 0; i < count; ++i)
         {
-            spdlog::trace("[UdpForwardService::northRead] skip empty udp packet.");
-            continue;
-        }
+            if (msgs[i].msg_len == 0)
+            {
+                spdlog::trace("[UdpForwardService::northRead] skip empty udp packet.");
+                continue;
+            }
 
-        // get buffer
-        auto pBufBlk = mpToNorthDynamicBuffer->getBufBlk(pktLen);
-        if (pBufBlk == nullptr)
+            // 判断数据包来源是否合法
+            if (Utils::compareAddr(&addrs[i], &remoteAddr))
+            {
+                // drop unknown incoming packet
+                spdlog::debug("[UdpForwardService::northRead] drop invalid addr[{}] pkt at tunnel[{}] for {}. drop it",
+                              Utils::dumpSockAddr(addrs[i]), pe->soc, Utils::dumpSockAddr(remoteAddr));
+                continue;
+            }
+            indexes[pkts] = i;
+            sizes[pkts++] = msgs[i].msg_len;
+        }
+        DynamicBuffer::BufBlk_t *pBufBlks[MMSG_BATCH_SIZE];
+        uint32_t allocated = mpToSouthDynamicBuffer->getBufBlks(sizes, pkts, pBufBlks);
+        if (allocated < pkts)
         {
             // out of buffer
-            spdlog::trace("[UdpForwardService::northRead] out of buffer, drop packet");
-            recv(pe->soc, NULL, 0, 0);
-            break;
+            spdlog::trace("[UdpForwardService::northRead] out of buffer, drop {} packets", pkts - allocated);
+            outOfBuffer = true;
         }
 
-        auto pt = (Tunnel_t *)pe->container;
-
-        int nRet = recvfrom(pe->soc, pBufBlk->buffer, pktLen, 0, (sockaddr *)&pBufBlk->srcAddr, &addrLen);
-
-        // 判断数据包来源是否合法
-        if (Utils::compareAddr(&pBufBlk->srcAddr, &pe->conn.remoteAddr))
+        for (uint32_t j = 0; j < allocated; ++j)
         {
-            // drop unknown incoming packet
-            spdlog::debug("[UdpForwardService::northRead] drop invalid addr[{}] pkt at tunnel[{}] for {}. drop it",
-                          Utils::dumpSockAddr(pBufBlk->srcAddr), pe->soc, Utils::dumpSockAddr(pe->conn.remoteAddr));
+            int i = indexes[j];
+            uint32_t pktLen = msgs[i].msg_len;
+            auto pBufBlk = pBufBlks[j];
+
+            memcpy(pBufBlk->buffer, iovs[i].iov_base, pktLen);
+            pBufBlk->segSize = getSegSize(&msgs[i]);
+            pBufBlk->srcAddr = serviceAddr;
+            pBufBlk->dstAddr = clientAddr;
+            if (!mToSouthPktRing.push(pBufBlk))
+            {
+                // south thread falls behind, 释放本批余下的数据块
+                spdlog::trace("[UdpForwardService::northRead] packet ring is full, drop {} packets", allocated - j);
+                for (; j < allocated; ++j)
+                {
+                    mpToSouthDynamicBuffer->release(pBufBlks[j]);
+                }
+                outOfBuffer = true;
+                break;
+            }
+
+            mTimeoutTimer.refresh(Clock::ms(), &pt->timerEntity);
         }
-        else
-        {
-            pBufBlk->srcAddr = pe->peer->conn.localAddr; // pe->conn.localAddr --> service's ip-port
-            pBufBlk->dstAddr = pe->conn.localAddr;       // pe->conn.localAddr --> south(client)'s ip-port
-            recvList.push_back(pBufBlk);
 
-            mTimeoutTimer.refresh(curTime, &pt->timerEntity);
+        if (count < (int)MMSG_BATCH_SIZE)
+        {
+            // 接收队列已空
+            break;
         }
     }
 
-    // merge receive list
-    {
-        lock_guard<mutex> lg(mAccessMutex);
-        mToSouthPktList.splice(mToSouthPktList.end(), recvList);
-    }
+    // hand over to south thread
+    mToSouthPktRing.publish() && (notify(mpToSouthNotifier), true);
 }
 
-void UdpForwardService::northWrite(time_t curTime, Endpoint_t *pe)
+void UdpForwardService::northWrite(Endpoint_t *pe)
 {
     if (!pe->valid)
     {
@@ -887,13 +1170,7 @@ void UdpForwardService::northWrite(time_t curTime, Endpoint_t *pe)
         if (pe->sendListHead)
         {
             // clean buffer list
-            auto p = (DynamicBuffer::BufBlk_t *)pe->sendListHead;
-            while (p)
-            {
-                auto next = p->next;
-                mpToNorthDynamicBuffer->release(p);
-                p = next;
-            }
+            mpToNorthDynamicBuffer->releaseList((DynamicBuffer::BufBlk_t *)pe->sendListHead);
             pe->sendListHead = pe->sendListTail = nullptr;
             pe->totalBufSize = 0;
         }
@@ -904,19 +1181,29 @@ void UdpForwardService::northWrite(time_t curTime, Endpoint_t *pe)
     if (!p)
     {
         // stop send
-        epollResetEndpointMode(mForwardEpollfd, pe, true, false, false);
+        epollResetEndpointMode(mpForwardPoller, pe, true, false, false);
         return;
     }
 
+    mmsghdr msgs[MMSG_BATCH_SIZE];
+    iovec iovs[MMSG_BATCH_SIZE];
+    alignas(cmsghdr) char ctrls[MMSG_BATCH_SIZE * SEG_CMSG_SPACE];
     while (p)
     {
-        int nRet = send(pe->soc, p->buffer, p->dataSize, 0);
-        if (nRet > 0)
+        // 将发送链表中的数据包汇集起来, 一次发送 (socket 已 connect, 无需指定地址)
+        uint32_t count = 0;
+        for (auto pkt = p; pkt && count < MMSG_BATCH_SIZE; pkt = pkt->next, ++count)
         {
-            assert(nRet == p->dataSize);
-            mTimeoutTimer.refresh(curTime, &((Tunnel_t *)pe->container)->timerEntity);
+            iovs[count].iov_base = pkt->buffer;
+            iovs[count].iov_len = pkt->dataSize;
+            msgs[count].msg_hdr = msghdr{};
+            msgs[count].msg_hdr.msg_iov = &iovs[count];
+            msgs[count].msg_hdr.msg_iovlen = 1;
+            setSegSize(&msgs[count], ctrls + count * SEG_CMSG_SPACE, pkt->segSize);
         }
-        else if (nRet < 0)
+
+        int nRet = sendmmsg(pe->soc, msgs, count, 0);
+        if (nRet < 0)
         {
             if (errno == EAGAIN)
             {
@@ -926,7 +1213,7 @@ void UdpForwardService::northWrite(time_t curTime, Endpoint_t *pe)
             else if (errno == EINTR)
             {
                 // 此次数据发送被中断，继续尝试发送数据
-                spdlog::debug("[UdpForwardService::northRead] broken by interrupt, try again.");
+                spdlog::debug("[UdpForwardService::northWrite] broken by interrupt, try again.");
                 continue;
             }
 
@@ -939,18 +1226,18 @@ void UdpForwardService::northWrite(time_t curTime, Endpoint_t *pe)
 
             break;
         }
-        else
+        mTimeoutTimer.refresh(Clock::ms(), &((Tunnel_t *)pe->container)->timerEntity);
+
+        // release sent buffer: 已发送的数据包断开后一次归还
+        auto sent = p;
+        DynamicBuffer::BufBlk_t *last = nullptr;
+        for (int i = 0; i < nRet; ++i)
         {
-            // send ZERO data, drop pkt
-            spdlog::warn("[UdpForwardService::northWrite] send ZERO data, drop pkt");
+            pe->totalBufSize -= p->dataSize;
+            last = p;
+            p = p->next;
         }
-
-        pe->totalBufSize -= p->dataSize;
-        auto next = p->next;
-
-        mpToNorthDynamicBuffer->release(p);
-
-        p = next;
+        last && (last->next = nullptr, mpToNorthDynamicBuffer->releaseList(sent), true);
     }
 
     if (p)
@@ -967,31 +1254,27 @@ void UdpForwardService::northWrite(time_t curTime, Endpoint_t *pe)
     }
 }
 
-void UdpForwardService::processToNorthPkts(time_t curTime)
+void UdpForwardService::processToNorthPkts()
 {
-    list<DynamicBuffer::BufBlk_t *> pktList;
-    {
-        lock_guard<mutex> scopeLock(mAccessMutex);
-        pktList.splice(pktList.end(), mToNorthPktList);
-    }
-
-    if (pktList.empty())
-    {
-        return;
-    }
-    for (auto pBufBlk : pktList)
-    {
+    mToNorthPktRing.consume([&](DynamicBuffer::BufBlk_t *pBufBlk) {
 #ifdef ENABLE_DETAIL_LOGS
         spdlog::debug("[UdpForwardService::processToNorthPkts] search service endpoint by[{}]",
                       Utils::dumpSockAddr(pBufBlk->dstAddr));
 #endif // ENABLE_DETAIL_LOGS
 
-        // 查找对应 UDP tunnel
-        auto pseIt = mAddr2ServiceEndpoint.find(pBufBlk->dstAddr);
-        assert(pseIt != mAddr2ServiceEndpoint.end());
+        // 收包的 service endpoint 由 south 线程随数据包传递 (mAddr2ServiceEndpoint 只由 south 线程访问),
+        // south 线程重新初始化环境后已释放的 endpoint 解析为 nullptr
+        auto pse = Endpoint::fromHandle(pBufBlk->tag);
+        if (!pse)
+        {
+            spdlog::debug("[UdpForwardService::processToNorthPkts] service endpoint of {} closed, drop packet",
+                          Utils::dumpSockAddr(pBufBlk->dstAddr));
+            mpToNorthDynamicBuffer->release(pBufBlk);
+            return;
+        }
 
         // 查找/分配对应 UDP tunnel
-        auto pt = getTunnel(curTime, pseIt->second, (sockaddr_in *)&pBufBlk->srcAddr);
+        auto pt = getTunnel(pse, (sockaddr_in *)&pBufBlk->srcAddr);
         if (pt)
         {
             // append packets to send list
@@ -999,47 +1282,66 @@ void UdpForwardService::processToNorthPkts(time_t curTime)
             pBufBlk->next = nullptr;
             if (Endpoint::appendToSendList(pt->north, pBufBlk))
             {
-                epollResetEndpointMode(mForwardEpollfd, pt->north, true, true, false);
+                epollResetEndpointMode(mpForwardPoller, pt->north, true, true, false);
             }
         }
         else
         {
             spdlog::trace("[UdpForwardService::processToNorthPkts] tunnel closed");
         }
-    }
-    pktList.clear();
+    });
 }
 
-void UdpForwardService::processToSouthPkts(time_t curTime)
+void UdpForwardService::processToSouthPkts()
 {
-    list<DynamicBuffer::BufBlk_t *> pktList;
-    {
-        lock_guard<mutex> scopeLock(mAccessMutex);
-        pktList.splice(pktList.end(), mToSouthPktList);
-    }
-
-    if (pktList.empty())
-    {
-        return;
-    }
-    for (auto pBufBlk : pktList)
-    {
+    mToSouthPktRing.consume([&](DynamicBuffer::BufBlk_t *pBufBlk) {
 #ifdef ENABLE_DETAIL_LOGS
         spdlog::debug("[UdpForwardService::processToSouthPkts] search service endpoint by[{}]",
                       Utils::dumpSockAddr(pBufBlk->dstAddr));
 #endif // ENABLE_DETAIL_LOGS
 
         // 查找对应 Service Endpoint
-        auto pseIt = mAddr2ServiceEndpoint.find(pBufBlk->srcAddr);
-        assert(pseIt != mAddr2ServiceEndpoint.end());
-        auto pse = pseIt->second;
+        auto ppse = mAddr2ServiceEndpoint.find(Utils::addrKey(pBufBlk->srcAddr));
+        if (!ppse)
+        {
+            // south 线程重新初始化环境前转发的数据包
+            spdlog::debug("[UdpForwardService::processToSouthPkts] no service endpoint of {}, drop packet",
+                          Utils::dumpSockAddr(pBufBlk->srcAddr));
+            mpToSouthDynamicBuffer->release(pBufBlk);
+            return;
+        }
+        auto pse = *ppse;
 
         if (Endpoint::appendToSendList(pse, pBufBlk))
         {
-            epollResetEndpointMode(mServiceEpollfd, pse, true, true, false);
+            epollResetEndpointMode(mpServicePoller, pse, true, true, false);
         }
-    }
-    pktList.clear();
+    });
+}
+
+bool UdpForwardService::createNotifiers()
+{
+    mpToNorthNotifier || (mpToNorthNotifier = createNotifier(PROTOCOL_UDP, TO_NORTH));
+    mpToSouthNotifier || (mpToSouthNotifier = createNotifier(PROTOCOL_UDP, TO_SOUTH));
+
+    return mpToNorthNotifier && mpToSouthNotifier;
+}
+
+void UdpForwardService::closeNotifiers()
+{
+    releaseNotifier(mpToNorthNotifier);
+    releaseNotifier(mpToSouthNotifier);
+}
+
+void UdpForwardService::releasePkts()
+{
+    // 线程已退出, 释放未处理的数据包
+    mToNorthPktRing.consume([&](DynamicBuffer::BufBlk_t *pBufBlk) {
+        mpToNorthDynamicBuffer->release(pBufBlk);
+    });
+    mToSouthPktRing.consume([&](DynamicBuffer::BufBlk_t *pBufBlk) {
+        mpToSouthDynamicBuffer->release(pBufBlk);
+    });
 }
 
 void UdpForwardService::closeTunnels()
@@ -1051,10 +1353,9 @@ void UdpForwardService::closeTunnels()
             spdlog::debug("[UdpForwardService::closeTunnels] close tunnel[{}]",
                           pt->north->soc);
 
-            // remove from maps
+            // remove from maps, 以创建时保存的键删除 (pt->south 为 south 线程的服务端点, 可能已被释放)
             int northSoc = pt->north->soc;
-            mAddr2Tunnel.erase(pt->north->conn.localAddr); // pe->conn.localAddr --> south(client)'s ip-port
-            mSoc2Tunnel.erase(northSoc);
+            mFlow2Tunnel.erase({Tunnel::cold(pt)->serviceKey, Tunnel::cold(pt)->clientKey});
 
             // remove from timer
             mTimeoutTimer.erase(&pt->timerEntity);
@@ -1063,6 +1364,7 @@ void UdpForwardService::closeTunnels()
             releaseEndpointBuffer(pt->north);
 
             // close and release endpoint object
+            mpForwardPoller && (epollRemoveEndpoint(mpForwardPoller, pt->north), true);
             ::close(northSoc);
             Endpoint::releaseEndpoint(pt->north);
             // release tunnel object
@@ -1078,14 +1380,7 @@ void UdpForwardService::releaseEndpointBuffer(Endpoint_t *pe)
     if (pe && pe->sendListHead)
     {
         assert(pe->direction == TO_NORTH);
-        auto pkt = (DynamicBuffer::BufBlk_t *)pe->sendListHead;
-        while (pkt)
-        {
-
-            auto next = pkt->next;
-            mpToNorthDynamicBuffer->release(pkt);
-            pkt = next;
-        }
+        mpToNorthDynamicBuffer->releaseList((DynamicBuffer::BufBlk_t *)pe->sendListHead);
         pe->sendListHead = pe->sendListTail = nullptr;
         pe->totalBufSize = 0;
     }
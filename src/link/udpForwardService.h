@@ -11,17 +11,23 @@
 #ifndef __MAPPER_LINK_UDPFORWARDSERVICE_H__
 #define __MAPPER_LINK_UDPFORWARDSERVICE_H__
 
+#include <atomic>
 #include <list>
-#include <mutex>
 #include <set>
 #include <string>
 #include <thread>
+#include <vector>
+#include <sys/socket.h>
 #include "forward.h"
+#include "poller.h"
 #include "service.h"
 #include "targetMgr.h"
 #include "utils.h"
 #include "../buffer/dynamicBuffer.h"
-#include "../utils/timerList.h"
+#include "../utils/flatHashMap.h"
+#include "../utils/clock.h"
+#include "../utils/spscRing.h"
+#include "../utils/timingWheel.h"
 
 namespace mapper
 {
@@ -32,12 +38,33 @@ class UdpForwardService : public Service
 {
 protected:
     static const uint32_t EPOLL_THREAD_RETRY_INTERVAL;
-    static const uint32_t EPOLL_MAX_EVENTS;
-    static const uint32_t INTERVAL_EPOLL_WAIT_TIME;
     static const uint32_t PREALLOC_RECV_BUFFER_SIZE;
-    using Addr2TunIter = std::map<sockaddr_in, Tunnel_t *>::iterator;
+    static const uint32_t PKT_RING_SIZE;
+    static const uint32_t MMSG_BATCH_SIZE; // packets per recvmmsg/sendmmsg
 
-    UdpForwardService(const UdpForwardService &) : Service(""){};
+    // key of udp flow: service address and client address (Utils::addrKey)
+    struct FlowKey_t
+    {
+        uint64_t service;
+        uint64_t client;
+
+        inline bool operator==(const FlowKey_t &r) const { return service == r.service && client == r.client; }
+    };
+    struct FlowKeyHash_t
+    {
+        inline uint64_t operator()(const FlowKey_t &key) const
+        {
+            return key.service * 0x9e3779b97f4a7c15ULL ^ key.client;
+        }
+    };
+
+    // settings of a service, loaded from the options of its forward
+    struct ServiceSetting_t
+    {
+        bool offload; // receive by UDP_GRO on service and north sockets
+    };
+
+    UdpForwardService(const UdpForwardService &) : Service(""), mToNorthPktRing(0), mToSouthPktRing(0){};
     UdpForwardService &operator=(const UdpForwardService &) { return *this; }
 
 public:
@@ -60,19 +87,28 @@ protected:
     bool initSouthEnv();
     void closeNorthEnv();
     void closeSouthEnv();
-    void onTunnelSoc(time_t curTime, Endpoint_t *pe);
-    bool doNorthEpoll(time_t curTime, int epollfd);
-    bool doSouthEpoll(time_t curTime, int epollfd);
-    void postProcess(time_t curTime);
-    void scanTimeout(time_t curTime);
-
-    Tunnel_t *getTunnel(time_t curTime, Endpoint_t *pse, sockaddr_in *pSAI);
-    void southRead(time_t curTime, Endpoint_t *pse);
-    void southWrite(time_t curTime, Endpoint_t *pe);
-    void northRead(time_t curTime, Endpoint_t *pe);
-    void northWrite(time_t curTime, Endpoint_t *pe);
-    void processToNorthPkts(time_t curTime);
-    void processToSouthPkts(time_t curTime);
+    void onTunnelSoc(Endpoint_t *pe);
+    bool doNorthEpoll(int timeout);
+    bool doSouthEpoll(int timeout);
+    void postProcess();
+    void scanTimeout();
+
+    Tunnel_t *getTunnel(Endpoint_t *pse, sockaddr_in *pSAI);
+    static void prepareRecvMsgs(mmsghdr *msgs, iovec *iovs, sockaddr_in *addrs, char *buffer, char *ctrls);
+    static uint32_t getSegSize(mmsghdr *msg);
+    static void setSegSize(mmsghdr *msg, char *ctrl, uint32_t segSize);
+    static bool loadServiceSetting(const Forward &forward, ServiceSetting_t &setting);
+    static void enableGro(int soc);
+    void southRead(Endpoint_t *pse);
+    void southWrite(Endpoint_t *pe);
+    void northRead(Endpoint_t *pe);
+    void northWrite(Endpoint_t *pe);
+    void processToNorthPkts();
+    void processToSouthPkts();
+
+    bool createNotifiers();
+    void closeNotifiers();
+    void releasePkts();
 
     inline void addToCloseList(Tunnel_t *pt) { mCloseList.insert(pt); };
     inline void addToCloseList(Endpoint_t *pe)
@@ -82,33 +118,47 @@ protected:
     void closeTunnels();
     void releaseEndpointBuffer(Endpoint_t *pe);
 
-    int mServiceEpollfd;
-    int mForwardEpollfd;
+    Poller *mpServicePoller;
+    Poller *mpForwardPoller;
     std::thread mSouthThread;
     std::thread mNorthThread;
     volatile bool mStopFlag;
 
-    std::mutex mAccessMutex;
-    std::list<buffer::DynamicBuffer::BufBlk_t *> mToNorthPktList;
-    std::list<buffer::DynamicBuffer::BufBlk_t *> mToSouthPktList;
+    // packets handed between threads: south thread -> north thread, and the reverse
+    utils::SpscRing<buffer::DynamicBuffer::BufBlk_t *> mToNorthPktRing;
+    utils::SpscRing<buffer::DynamicBuffer::BufBlk_t *> mToSouthPktRing;
+    // eventfd, signaled when a ring turns from empty to non-empty, polled by the consumer
+    Endpoint_t *mpToNorthNotifier;
+    Endpoint_t *mpToSouthNotifier;
+    // events of one wait, and whether events were handled since the last housekeeping
+    std::vector<epoll_event> mNorthEvents;
+    std::vector<epoll_event> mSouthEvents;
+    bool mNorthBusy;
+    bool mSouthBusy;
+
+    // recvmmsg slots of each thread, packets are copied into DynamicBuffer in their exact size
+    std::vector<char> mSouthRecvBuffer;
+    std::vector<char> mNorthRecvBuffer;
 
     std::list<std::shared_ptr<Forward>> mForwardList;
     Service::Setting_t mSetting;
     buffer::DynamicBuffer *mpToNorthDynamicBuffer;
     buffer::DynamicBuffer *mpToSouthDynamicBuffer;
     std::set<Tunnel_t *> mCloseList;
-    utils::TimerList mTimeoutTimer;
+    utils::TimingWheel mTimeoutTimer; // north thread only
     TargetManager mTargetManager;
 
-    std::map<sockaddr_in, Endpoint_t *, Utils::Comparator_t> mAddr2ServiceEndpoint;
-    std::map<sockaddr_in, Tunnel_t *, Utils::Comparator_t> mAddr2Tunnel;
-    std::map<int, Tunnel_t *> mSoc2Tunnel;
+    utils::FlatHashMap<uint64_t, Endpoint_t *> mAddr2ServiceEndpoint; // key: Utils::addrKey(), south thread only
+    std::list<ServiceSetting_t> mServiceSettingList; // referred by service endpoint's container
+    utils::FlatHashMap<FlowKey_t, Tunnel_t *, FlowKeyHash_t> mFlow2Tunnel;
 
     // for statistic
     volatile float mUp;
     volatile float mDown;
     volatile float mTotalUp;
     volatile float mTotalDown;
+    std::atomic<uint64_t> mCtlCount; // kernel registrations submitted by both pollers
+    uint64_t mLastCtlCount;          // mCtlCount at the last statistic
 };
 
 } // namespace link
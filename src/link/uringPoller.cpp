@@ -0,0 +1,550 @@
+#include "uringPoller.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <spdlog/spdlog.h>
+#include "endpoint.h"
+
+using namespace std;
+
+namespace mapper
+{
+namespace link
+{
+
+const uint32_t UringPoller::NO_BUFFER = UINT32_MAX;
+const uint32_t UringPoller::RING_ENTRIES = 1024;
+const uint16_t UringPoller::BUF_GROUP = 0;
+
+// poll 事件掩码与 epoll 一致 (EPOLLIN == POLLIN ...)，但不支持 EPOLLET 等 epoll 专有标志
+static const uint32_t POLL_EVENTS_MASK = 0xffff;
+
+UringPoller::UringPoller()
+    : mRingfd(0),
+      mSqRing(nullptr),
+      mSqRingSize(0),
+      mSqes(nullptr),
+      mSqesSize(0),
+      mToSubmit(0),
+      mCqRing(nullptr),
+      mCqRingSize(0),
+      mBufRing(nullptr),
+      mBufRingEntries(0),
+      mBufTail(0)
+{
+}
+
+UringPoller::~UringPoller()
+{
+    // 关闭 ring 时内核撤销全部请求并注销缓冲区环
+    mSqes && (munmap(mSqes, mSqesSize), mSqes = nullptr);
+    if (mCqRing && mCqRing != mSqRing)
+    {
+        munmap(mCqRing, mCqRingSize);
+    }
+    mCqRing = nullptr;
+    mSqRing && (munmap(mSqRing, mSqRingSize), mSqRing = nullptr);
+    mRingfd && (::close(mRingfd), (mRingfd = 0));
+    mBufRing && (munmap(mBufRing, mBufRingEntries * sizeof(io_uring_buf)), mBufRing = nullptr);
+}
+
+UringPoller *UringPoller::create()
+{
+    auto pPoller = new UringPoller();
+    if (!pPoller->init())
+    {
+        delete pPoller;
+        return nullptr;
+    }
+
+    return pPoller;
+}
+
+bool UringPoller::init()
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int ringfd = syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+    if (ringfd < 0)
+    {
+        spdlog::error("[UringPoller::init] io_uring_setup fail. {} - {}", errno, strerror(errno));
+        return false;
+    }
+    mRingfd = ringfd;
+
+    // 需要 IORING_ENTER_EXT_ARG 以支持带超时的等待 (linux 5.11+)
+    if (!(params.features & IORING_FEAT_EXT_ARG))
+    {
+        spdlog::error("[UringPoller::init] IORING_FEAT_EXT_ARG is not supported");
+        return false;
+    }
+
+    // map rings
+    mSqEntries = params.sq_entries;
+    mSqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    mCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap)
+    {
+        mSqRingSize = mCqRingSize = max(mSqRingSize, mCqRingSize);
+    }
+
+    mSqRing = mmap(nullptr, mSqRingSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, mRingfd, IORING_OFF_SQ_RING);
+    if (mSqRing == MAP_FAILED)
+    {
+        spdlog::error("[UringPoller::init] mmap sq ring fail. {} - {}", errno, strerror(errno));
+        mSqRing = nullptr;
+        return false;
+    }
+    if (singleMmap)
+    {
+        mCqRing = mSqRing;
+    }
+    else
+    {
+        mCqRing = mmap(nullptr, mCqRingSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, mRingfd, IORING_OFF_CQ_RING);
+        if (mCqRing == MAP_FAILED)
+        {
+            spdlog::error("[UringPoller::init] mmap cq ring fail. {} - {}", errno, strerror(errno));
+            mCqRing = nullptr;
+            return false;
+        }
+    }
+    mSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    mSqes = (io_uring_sqe *)mmap(nullptr, mSqesSize, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, mRingfd, IORING_OFF_SQES);
+    if (mSqes == MAP_FAILED)
+    {
+        spdlog::error("[UringPoller::init] mmap sqes fail. {} - {}", errno, strerror(errno));
+        mSqes = nullptr;
+        return false;
+    }
+
+    auto sq = (char *)mSqRing;
+    mSqHead = (uint32_t *)(sq + params.sq_off.head);
+    mSqTail = (uint32_t *)(sq + params.sq_off.tail);
+    mSqMask = (uint32_t *)(sq + params.sq_off.ring_mask);
+    mSqArray = (uint32_t *)(sq + params.sq_off.array);
+
+    auto cq = (char *)mCqRing;
+    mCqHead = (uint32_t *)(cq + params.cq_off.head);
+    mCqTail = (uint32_t *)(cq + params.cq_off.tail);
+    mCqMask = (uint32_t *)(cq + params.cq_off.ring_mask);
+    mCqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    spdlog::debug("[UringPoller::init] io_uring created, sq[{}] cq[{}]",
+                  params.sq_entries, params.cq_entries);
+
+    return true;
+}
+
+
+bool UringPoller::add(Endpoint_t *pe, uint32_t events)
+{
+    if (pe->pollState != POLLSTAT_NONE)
+    {
+        errno = EEXIST;
+        return false;
+    }
+
+    pe->pollEvents = events & POLL_EVENTS_MASK;
+    arm(pe);
+
+    return pe->pollState == POLLSTAT_ARMED;
+}
+
+bool UringPoller::modify(Endpoint_t *pe, uint32_t events)
+{
+    if (pe->pollState != POLLSTAT_ARMED && pe->pollState != POLLSTAT_FIRED)
+    {
+        errno = ENOENT;
+        return false;
+    }
+
+    events &= POLL_EVENTS_MASK;
+    if (pe->pollEvents == events)
+    {
+        return true;
+    }
+    pe->pollEvents = events;
+
+    if (pe->pollState == POLLSTAT_ARMED)
+    {
+        // 撤销原请求并以新的事件掩码重新注册; 已触发的请求将在下一次 wait() 时重新注册
+        cancel(pe);
+        arm(pe);
+    }
+
+    return true;
+}
+
+bool UringPoller::remove(Endpoint_t *pe)
+{
+    switch (pe->pollState)
+    {
+    case POLLSTAT_ARMED:
+        cancel(pe);
+        break;
+    case POLLSTAT_FIRED:
+        // 不再重新注册, 见 wait()
+        break;
+    case POLLSTAT_ASYNC:
+    {
+        // 撤销该 socket 上的全部请求; 以 fd 撤销须在关闭 socket 之前提交
+        auto sqe = getSqe();
+        if (!sqe)
+        {
+            spdlog::error("[UringPoller::remove] cancel requests of soc[{}] fail", pe->soc);
+            errno = EBUSY;
+            return false;
+        }
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = pe->soc;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        sqe->user_data = 0;
+        enter(mToSubmit, 0, 0, nullptr, 0);
+    }
+    break;
+    default:
+        errno = ENOENT;
+        return false;
+    }
+
+    pe->pollState = POLLSTAT_NONE;
+    return true;
+}
+
+int UringPoller::wait(epoll_event *events, int maxEvents, int timeout)
+{
+    mCompletions.clear();
+
+    // re-arm fired endpoints
+    for (auto handle : mRearmList)
+    {
+        auto pe = Endpoint::fromHandle(handle);
+        (pe && pe->pollState == POLLSTAT_FIRED) && (arm(pe), true);
+    }
+    mRearmList.clear();
+
+    // submit and wait
+    bool ready = *mCqHead != __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE);
+    int nRet;
+    if (ready || timeout == 0)
+    {
+        nRet = mToSubmit ? enter(mToSubmit, 0, 0, nullptr, 0) : 0;
+    }
+    else
+    {
+        __kernel_timespec ts;
+        io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        if (timeout > 0)
+        {
+            ts.tv_sec = timeout / 1000;
+            ts.tv_nsec = (timeout % 1000) * 1000000;
+            arg.ts = (uint64_t)&ts;
+        }
+        nRet = enter(mToSubmit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    }
+    if (nRet < 0 && errno != ETIME)
+    {
+        return -1;
+    }
+
+    // reap completions, 就绪事件与完成事件合计不超过 maxEvents
+    uint32_t head = *mCqHead;
+    uint32_t tail = __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE);
+    int count = 0;
+    while (head != tail && count + (int)mCompletions.size() < maxEvents)
+    {
+        auto cqe = &mCqes[head & *mCqMask];
+        ++head;
+
+        if (cqe->user_data == 0)
+        {
+            // 撤销请求的完成事件
+            continue;
+        }
+
+        // 请求的最后一个完成事件, 回收请求表项
+        uint32_t index = cqe->user_data - 1;
+        Request_t req = mRequests[index];
+        bool more = cqe->flags & IORING_CQE_F_MORE;
+        more || (freeRequest(index), true);
+
+        auto pe = req.endpoint ? Endpoint::fromHandle(req.endpoint) : nullptr;
+        if (req.op == OP_POLL)
+        {
+            if (!pe || cqe->res == -ECANCELED)
+            {
+                // 已撤销的 poll 请求, 或端点已释放
+                continue;
+            }
+            mPolls.erase(req.endpoint);
+
+            events[count].data.ptr = pe;
+            events[count].events = cqe->res < 0
+                                       ? EPOLLERR | (pe->pollEvents & (EPOLLIN | EPOLLOUT))
+                                       : (uint32_t)cqe->res;
+            ++count;
+
+            pe->pollState = POLLSTAT_FIRED;
+            mRearmList.push_back(req.endpoint);
+        }
+        else
+        {
+            // 端点已释放时仍需返回, 由使用者归还其中的缓冲区
+            (req.op == OP_RECV && (cqe->flags & IORING_CQE_F_BUFFER)) &&
+                (req.bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+            mCompletions.push_back({pe, req.op, more, cqe->res, req.bid});
+        }
+    }
+    __atomic_store_n(mCqHead, head, __ATOMIC_RELEASE);
+
+    return count;
+}
+
+bool UringPoller::setupBufRing(uint32_t entries)
+{
+    size_t size = entries * sizeof(io_uring_buf);
+    auto ring = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (ring == MAP_FAILED)
+    {
+        spdlog::error("[UringPoller::setupBufRing] mmap buffer ring fail. {} - {}", errno, strerror(errno));
+        return false;
+    }
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)ring;
+    reg.ring_entries = entries;
+    reg.bgid = BUF_GROUP;
+    if (syscall(__NR_io_uring_register, mRingfd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        spdlog::error("[UringPoller::setupBufRing] register buffer ring fail. {} - {}", errno, strerror(errno));
+        munmap(ring, size);
+        return false;
+    }
+
+    mBufRing = (io_uring_buf *)ring;
+    mBufRingEntries = entries;
+    mBufTail = 0;
+
+    return true;
+}
+
+void UringPoller::provide(uint32_t bid, char *buf, uint32_t size)
+{
+    auto p = &mBufRing[mBufTail & (mBufRingEntries - 1)];
+    p->addr = (uint64_t)buf;
+    p->len = size;
+    p->bid = bid;
+    __atomic_store_n(&mBufRing[0].resv, ++mBufTail, __ATOMIC_RELEASE);
+}
+
+bool UringPoller::accept(Endpoint_t *pe)
+{
+    auto sqe = submit(OP_ACCEPT, pe, NO_BUFFER);
+    if (!sqe)
+    {
+        return false;
+    }
+
+    // 每个新连接产生一个完成事件, 直至出错或被撤销 (more == false)
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = pe->soc;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+
+    return true;
+}
+
+bool UringPoller::connect(Endpoint_t *pe, const sockaddr_in *addr)
+{
+    auto sqe = submit(OP_CONNECT, pe, NO_BUFFER);
+    if (!sqe)
+    {
+        return false;
+    }
+
+    sqe->opcode = IORING_OP_CONNECT;
+    sqe->fd = pe->soc;
+    sqe->addr = (uint64_t)addr;
+    sqe->off = sizeof(sockaddr_in);
+
+    return true;
+}
+
+bool UringPoller::recv(Endpoint_t *pe)
+{
+    auto sqe = submit(OP_RECV, pe, NO_BUFFER);
+    if (!sqe)
+    {
+        return false;
+    }
+
+    // 有数据到达时才选取缓冲区, 长度为所选缓冲区的大小; 缓冲区环为空时以 -ENOBUFS 完成
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = pe->soc;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUF_GROUP;
+
+    return true;
+}
+
+bool UringPoller::relay(Endpoint_t *pe, uint32_t bid, const char *buf, uint32_t size, Endpoint_t *receiver)
+{
+    if (!reserve(2))
+    {
+        return false;
+    }
+
+    auto sqe = submit(OP_SEND, pe, bid);
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = pe->soc;
+    sqe->addr = (uint64_t)buf;
+    sqe->len = size;
+    // 发送全部数据后才完成, 未全部发出 (出错) 时其后链接的接收以 -ECANCELED 完成
+    sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+    sqe->flags = IOSQE_IO_LINK;
+
+    return recv(receiver);
+}
+
+bool UringPoller::reserve(uint32_t count)
+{
+    if (*mSqTail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE) + count > mSqEntries)
+    {
+        // 提交队列空间不足，先行提交
+        enter(mToSubmit, 0, 0, nullptr, 0);
+        if (*mSqTail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE) + count > mSqEntries)
+        {
+            spdlog::error("[UringPoller::reserve] submission queue is full");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+io_uring_sqe *UringPoller::getSqe()
+{
+    if (!reserve(1))
+    {
+        return nullptr;
+    }
+
+    uint32_t tail = *mSqTail;
+    uint32_t index = tail & *mSqMask;
+    auto sqe = &mSqes[index];
+    memset(sqe, 0, sizeof(io_uring_sqe));
+    mSqArray[index] = index;
+    __atomic_store_n(mSqTail, tail + 1, __ATOMIC_RELEASE);
+    ++mToSubmit;
+    countCtl();
+
+    return sqe;
+}
+
+uint32_t UringPoller::allocRequest(Op_t op, Endpoint_t *pe, uint32_t bid)
+{
+    uint32_t index;
+    if (mFreeRequests.empty())
+    {
+        index = mRequests.size();
+        mRequests.push_back({});
+    }
+    else
+    {
+        index = mFreeRequests.back();
+        mFreeRequests.pop_back();
+    }
+
+    auto &req = mRequests[index];
+    req.endpoint = Endpoint::handle(pe);
+    req.op = op;
+    req.bid = bid;
+
+    return index;
+}
+
+io_uring_sqe *UringPoller::submit(Op_t op, Endpoint_t *pe, uint32_t bid)
+{
+    auto sqe = getSqe();
+    if (!sqe)
+    {
+        spdlog::error("[UringPoller::submit] submit request[{}] of soc[{}] fail", (int)op, pe->soc);
+        errno = EBUSY;
+        return nullptr;
+    }
+
+    sqe->user_data = allocRequest(op, pe, bid) + 1;
+    pe->pollState = POLLSTAT_ASYNC;
+
+    return sqe;
+}
+
+void UringPoller::arm(Endpoint_t *pe)
+{
+    auto sqe = getSqe();
+    if (!sqe)
+    {
+        spdlog::error("[UringPoller::arm] arm soc[{}] fail", pe->soc);
+        pe->pollState = POLLSTAT_NONE;
+        return;
+    }
+
+    uint32_t index = allocRequest(OP_POLL, pe, NO_BUFFER);
+    mPolls.insert(Endpoint::handle(pe), index);
+    pe->pollState = POLLSTAT_ARMED;
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = pe->soc;
+    sqe->poll32_events = pe->pollEvents;
+    sqe->user_data = index + 1;
+}
+
+void UringPoller::cancel(Endpoint_t *pe)
+{
+    auto handle = Endpoint::handle(pe);
+    auto pIndex = mPolls.find(handle);
+    if (!pIndex)
+    {
+        return;
+    }
+
+    // 原请求此后 (包括已位于完成队列中) 的完成事件均被丢弃, 其表项于最后一个完成事件到达时回收
+    uint32_t index = *pIndex;
+    mRequests[index].endpoint = 0;
+    mPolls.erase(handle);
+
+    auto sqe = getSqe();
+    if (!sqe)
+    {
+        // 请求仍然有效, 触发后丢弃, 不影响正确性
+        spdlog::error("[UringPoller::cancel] cancel soc[{}] fail", pe->soc);
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->addr = index + 1;
+    sqe->user_data = 0;
+}
+
+int UringPoller::enter(uint32_t toSubmit, uint32_t minComplete, uint32_t flags, void *arg, size_t argSize)
+{
+    int nRet = syscall(__NR_io_uring_enter, mRingfd, toSubmit, minComplete, flags, arg, argSize);
+
+    // 内核已取走的请求不再计入
+    mToSubmit = *mSqTail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE);
+
+    return nRet;
+}
+
+} // namespace link
+} // namespace mapper
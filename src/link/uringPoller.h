@@ -0,0 +1,159 @@
+/**
+ * @file uringPoller.h
+ * @author Liu Yu (source@liuyu.com)
+ * @brief io_uring backend of Poller.
+ * @version 1.0
+ * @date 2020-02-20
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef __MAPPER_LINK_URINGPOLLER_H__
+#define __MAPPER_LINK_URINGPOLLER_H__
+
+#include <linux/io_uring.h>
+#include <vector>
+#include "poller.h"
+#include "../utils/flatHashMap.h"
+
+namespace mapper
+{
+namespace link
+{
+
+/**
+ * io_uring 事件驱动:
+ *
+ * - 完成模式: accept (multishot)、connect、recv、send 以请求提交, 完成事件经 completions() 取得;
+ *   recv 从注册的缓冲区环 (provided buffer ring) 中选取缓冲区, 缓冲区由使用者以 provide() 放入;
+ *   relay() 将 send 与其后的 recv 链接提交 (IOSQE_IO_LINK): 发送完毕后才继续接收, 发送失败时接收被撤销
+ * - 就绪模式 (Poller 接口): 以单次触发的 IORING_OP_POLL_ADD 实现, 事件分发后于下一次 wait() 时
+ *   以当前事件掩码重新注册, 保持与 epoll 水平触发一致的语义
+ * - 每次 wait() 通过一次 io_uring_enter 同时提交所有挂起的请求并等待完成事件
+ * - 每个请求占用请求表中的一项, user_data 为其序号, 表项在请求的最后一个完成事件到达后才回收;
+ *   表项以 Endpoint::handle() 记录端点, 端点释放后的完成事件不会访问端点
+ * - remove() 撤销端点的全部请求, 以 fd 撤销的请求立即提交, 之后即可关闭 socket
+ */
+class UringPoller : public Poller
+{
+public:
+    enum Op_t : uint8_t
+    {
+        OP_POLL = 0,
+        OP_ACCEPT,
+        OP_CONNECT,
+        OP_RECV,
+        OP_SEND
+    };
+
+    static const uint32_t NO_BUFFER;
+
+    // 完成模式请求的完成事件
+    struct Completion_t
+    {
+        Endpoint_t *pe; // nullptr: 端点已释放
+        Op_t op;
+        bool more;    // multishot 请求仍然有效
+        int32_t res;  // 与对应系统调用的返回值一致, 失败时为 -errno
+        uint32_t bid; // recv: 选取的缓冲区, send: 发送的缓冲区, 否则为 NO_BUFFER
+    };
+
+protected:
+    static const uint32_t RING_ENTRIES;
+    static const uint16_t BUF_GROUP;
+
+    enum PollState_t
+    {
+        POLLSTAT_NONE = 0, // 未注册
+        POLLSTAT_ARMED,    // 已提交 poll 请求
+        POLLSTAT_FIRED,    // 已触发，等待重新注册
+        POLLSTAT_ASYNC     // 已提交完成模式的请求
+    };
+
+    struct Request_t
+    {
+        uint64_t endpoint; // Endpoint::handle(), 0: 已撤销
+        Op_t op;
+        uint32_t bid;
+    };
+
+    UringPoller();
+
+public:
+    virtual ~UringPoller();
+
+    static UringPoller *create();
+
+    Backend_t backend() override { return BACKEND_IO_URING; }
+    bool add(Endpoint_t *pe, uint32_t events) override;
+    bool modify(Endpoint_t *pe, uint32_t events) override;
+    bool remove(Endpoint_t *pe) override;
+    int wait(epoll_event *events, int maxEvents, int timeout) override;
+
+    // 注册 entries (2 的幂) 项的缓冲区环, 需要 linux 5.19+
+    bool setupBufRing(uint32_t entries);
+    // 将序号为 bid 的缓冲区放入缓冲区环, 供 recv 选取
+    void provide(uint32_t bid, char *buf, uint32_t size);
+
+    bool accept(Endpoint_t *pe);
+    bool connect(Endpoint_t *pe, const sockaddr_in *addr);
+    bool recv(Endpoint_t *pe);
+    // pe 发送缓冲区 bid 中的 size 字节, 全部发出后 receiver 继续接收
+    bool relay(Endpoint_t *pe, uint32_t bid, const char *buf, uint32_t size, Endpoint_t *receiver);
+    // 已提交完成模式的请求, 且尚未 remove()
+    inline bool submitted(const Endpoint_t *pe) const { return pe->pollState == POLLSTAT_ASYNC; }
+
+    // 上一次 wait() 收取的完成模式请求的完成事件
+    inline const std::vector<Completion_t> &completions() const { return mCompletions; }
+
+protected:
+    bool init();
+    // 确保提交队列中有 count 个空闲项, 链接的请求须位于同一次提交中
+    bool reserve(uint32_t count);
+    io_uring_sqe *getSqe();
+    uint32_t allocRequest(Op_t op, Endpoint_t *pe, uint32_t bid);
+    inline void freeRequest(uint32_t index) { mFreeRequests.push_back(index); }
+    // 提交完成模式的请求, 返回其 sqe, 失败时返回 nullptr
+    io_uring_sqe *submit(Op_t op, Endpoint_t *pe, uint32_t bid);
+    void arm(Endpoint_t *pe);
+    void cancel(Endpoint_t *pe);
+    int enter(uint32_t toSubmit, uint32_t minComplete, uint32_t flags, void *arg, size_t argSize);
+
+    int mRingfd;
+
+    // submission queue
+    void *mSqRing;
+    size_t mSqRingSize;
+    uint32_t *mSqHead;
+    uint32_t *mSqTail;
+    uint32_t *mSqMask;
+    uint32_t *mSqArray;
+    uint32_t mSqEntries;
+    io_uring_sqe *mSqes;
+    size_t mSqesSize;
+    uint32_t mToSubmit;
+
+    // completion queue
+    void *mCqRing;
+    size_t mCqRingSize;
+    uint32_t *mCqHead;
+    uint32_t *mCqTail;
+    uint32_t *mCqMask;
+    io_uring_cqe *mCqes;
+
+    // provided buffer ring, 环尾与首项的 resv 字段重叠
+    io_uring_buf *mBufRing;
+    uint32_t mBufRingEntries;
+    uint16_t mBufTail;
+
+    std::vector<Request_t> mRequests;
+    std::vector<uint32_t> mFreeRequests;
+    utils::FlatHashMap<uint64_t, uint32_t> mPolls; // Endpoint::handle() -> 已提交的 poll 请求
+    std::vector<uint64_t> mRearmList;              // Endpoint::handle() of fired endpoints
+    std::vector<Completion_t> mCompletions;
+};
+
+} // namespace link
+} // namespace mapper
+
+#endif // __MAPPER_LINK_URINGPOLLER_H__
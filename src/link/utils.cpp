@@ -2,8 +2,10 @@
 #include <assert.h>
 #include <ifaddrs.h>
 #include <string.h>
+#include <fstream>
 #include <sstream>
 #include <spdlog/spdlog.h>
+#include "endpoint.h"
 
 using namespace std;
 
@@ -220,10 +222,12 @@ bool Utils::setSocAttr(int soc, bool nonblock, bool reuse)
         }
     }
     // set reuse
+    // SO_REUSEPORT: 各 reactor 在同一地址上各自监听，由内核分发新连接
     if (reuse)
     {
         int opt = 1;
-        if (setsockopt(soc, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt)))
+        if (setsockopt(soc, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) ||
+            setsockopt(soc, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)))
         {
             spdlog::error("[Utils::setSocAttr] set reuse fail. {} - {}",
                           errno, strerror(errno));
@@ -374,7 +378,7 @@ std::string Utils::dumpEndpoint(const Endpoint_t *endpoint, bool reverse)
     if (reverse)
     {
         ss << "("
-           << dumpConnection(endpoint->conn, reverse)
+           << dumpConnection(Endpoint::cold(endpoint)->conn, reverse)
            << ",soc["
            << endpoint->soc
            << "])";
@@ -384,7 +388,7 @@ std::string Utils::dumpEndpoint(const Endpoint_t *endpoint, bool reverse)
         ss << "(soc["
            << endpoint->soc
            << "],"
-           << dumpConnection(endpoint->conn, reverse)
+           << dumpConnection(Endpoint::cold(endpoint)->conn, reverse)
            << ")";
     }
 
@@ -393,7 +397,7 @@ std::string Utils::dumpEndpoint(const Endpoint_t *endpoint, bool reverse)
 
 std::string Utils::dumpEndpoint(const Endpoint_t &endpoint, bool reverse)
 {
-    return dumpConnection(endpoint.conn, reverse);
+    return dumpConnection(Endpoint::cold(&endpoint)->conn, reverse);
 }
 
 std::string Utils::dumpServiceEndpoint(const Endpoint_t *serviceEndpoint, const sockaddr_in *clientAddr)
@@ -402,8 +406,8 @@ std::string Utils::dumpServiceEndpoint(const Endpoint_t *serviceEndpoint, const
 
     ss << "("
        << dumpSockAddr(clientAddr)
-       << (serviceEndpoint->conn.protocol == PROTOCOL_TCP ? "-tcp-" : "-udp-")
-       << dumpSockAddr(serviceEndpoint->conn.localAddr)
+       << (Endpoint::cold(serviceEndpoint)->conn.protocol == PROTOCOL_TCP ? "-tcp-" : "-udp-")
+       << dumpSockAddr(Endpoint::cold(serviceEndpoint)->conn.localAddr)
        << ",soc["
        << serviceEndpoint->soc
        << "])";
@@ -473,5 +477,27 @@ std::string Utils::toHumanStr(float num)
     return buffer;
 }
 
+uint64_t Utils::getMemoryLimit()
+{
+    static const char *LIMIT_FILES[] = {"/sys/fs/cgroup/memory.max",                    // cgroup v2
+                                        "/sys/fs/cgroup/memory/memory.limit_in_bytes"}; // cgroup v1
+    // cgroup v1 以接近 INT64_MAX 的 (按页对齐的) 数值表示不限制
+    static const uint64_t UNLIMITED = 1ULL << 62;
+
+    for (auto file : LIMIT_FILES)
+    {
+        ifstream ifs(file);
+        string value;
+        if (ifs >> value)
+        {
+            // cgroup v2 以 "max" 表示不限制
+            uint64_t limit = value == "max" ? 0 : strtoull(value.c_str(), nullptr, 10);
+            return limit < UNLIMITED ? limit : 0;
+        }
+    }
+
+    return 0;
+}
+
 } // namespace link
 } // namespace mapper
@@ -56,6 +56,11 @@ public:
     static int compareAddr(const sockaddr_in *l, const sockaddr_in *r);
     static int compareAddr(const sockaddr_in6 *l, const sockaddr_in6 *r);
     static int compareAddr(const addrinfo *l, const addrinfo *r);
+    // ipv4 address and port packed as an integer, for hash keys
+    static inline uint64_t addrKey(const sockaddr_in &addr)
+    {
+        return ((uint64_t)addr.sin_addr.s_addr << 16) | addr.sin_port;
+    }
 
     static std::string dumpSockAddr(const sockaddr *addr);
     static std::string dumpSockAddr(const sockaddr &addr);
@@ -71,6 +76,9 @@ public:
     static std::string dumpTunnel(const Tunnel_t &Tunnel, bool reverse = false);
 
     static std::string toHumanStr(float num);
+
+    // memory limit of the cgroup (v2 or v1) of this process, 0: unlimited or unknown
+    static uint64_t getMemoryLimit();
 };
 
 } // namespace link
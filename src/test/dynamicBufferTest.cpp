@@ -0,0 +1,173 @@
+/**
+ * @file dynamicBufferTest.cpp
+ * @author Liu Yu (source@liuyu.com)
+ * @brief Unit tests of buffer::DynamicBuffer: slab, remote free and trim paths.
+ * @version 1.0
+ * @date 2020-03-02
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include <string.h>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "../buffer/dynamicBuffer.h"
+#include "../utils/clock.h"
+
+using namespace mapper::buffer;
+using mapper::utils::Clock;
+
+namespace
+{
+
+const uint64_t CAPACITY = 16 * 1024 * 1024;
+const uint64_t CHUNK = 2 * 1024 * 1024; // DynamicBuffer::CHUNK_SIZE
+
+struct Buffer_t
+{
+    DynamicBuffer *p;
+
+    explicit Buffer_t(DynamicBuffer::Policy_t policy) : p(DynamicBuffer::allocDynamicBuffer(CAPACITY, policy)) {}
+    ~Buffer_t() { DynamicBuffer::releaseDynamicBuffer(p); }
+    DynamicBuffer *operator->() { return p; }
+};
+
+} // namespace
+
+// slab 数据块不计入首次适配区域的空闲量; 空闲链表为空时才按顺序切出新的数据块
+TEST(DynamicBufferTest, SlabAllocCarvesLazily)
+{
+    Buffer_t buffer(DynamicBuffer::POLICY_SLAB);
+    int64_t free = buffer->freeSize();
+    EXPECT_LT(free, (int64_t)CAPACITY);
+
+    auto a = buffer->getBufBlk(1000);
+    auto b = buffer->getBufBlk(2000);
+    ASSERT_NE(a, nullptr);
+    ASSERT_NE(b, nullptr);
+    EXPECT_EQ(buffer->freeSize(), free);
+    EXPECT_EQ(a->dataSize, 1000u);
+    EXPECT_GE(a->getBufSize(), 2048u);
+    EXPECT_EQ((char *)b, (char *)a + a->__innerBlockSize); // 同一级依次切出
+
+    // 释放后再次分配, 复用空闲链表中的数据块
+    buffer->release(a);
+    EXPECT_EQ(buffer->getBufBlk(500), a);
+    EXPECT_EQ(buffer->freeSize(), free);
+
+    // 超出最大一级的大小由首次适配分配
+    auto c = buffer->getBufBlk(100000);
+    ASSERT_NE(c, nullptr);
+    EXPECT_LT(buffer->freeSize(), free);
+
+    buffer->release(a);
+    buffer->release(b);
+    buffer->release(c);
+    EXPECT_EQ(buffer->freeSize(), free);
+    EXPECT_TRUE(buffer->check());
+}
+
+// 某一级用完后由首次适配分配, 全部释放后空闲量复原
+TEST(DynamicBufferTest, SlabExhaustedFallsBackToArena)
+{
+    Buffer_t buffer(DynamicBuffer::POLICY_SLAB);
+    int64_t free = buffer->freeSize();
+
+    std::vector<DynamicBuffer::BufBlk_t *> blks;
+    while (buffer->freeSize() == free)
+    {
+        auto p = buffer->getBufBlk(60000);
+        ASSERT_NE(p, nullptr);
+        blks.push_back(p);
+    }
+    // 最后一个来自首次适配区域
+    EXPECT_GT(blks.size(), 1u);
+    EXPECT_GT((char *)blks.back(), (char *)blks.front());
+
+    for (auto p : blks)
+    {
+        buffer->release(p);
+    }
+    EXPECT_EQ(buffer->freeSize(), free);
+    EXPECT_TRUE(buffer->check());
+}
+
+// 非所有者线程释放的数据块经无锁链表归还, 由所有者下次分配/查询时回收
+TEST(DynamicBufferTest, RemoteFree)
+{
+    for (auto policy : {DynamicBuffer::POLICY_FIRST_FIT, DynamicBuffer::POLICY_SLAB})
+    {
+        Buffer_t buffer(policy);
+        buffer->bindOwner();
+        int64_t free = buffer->freeSize();
+
+        auto small = buffer->getBufBlk(1000);
+        auto large = buffer->getBufBlk(300000);
+        ASSERT_NE(small, nullptr);
+        ASSERT_NE(large, nullptr);
+        int64_t used = free - buffer->freeSize();
+        EXPECT_GT(used, 0);
+
+        small->next = large;
+        large->next = nullptr;
+        std::thread([&]() { buffer->releaseList(small); }).join();
+
+        // 尚未回收
+        EXPECT_EQ(buffer->getStatistic().remoteFrees, 2u);
+        EXPECT_EQ(buffer->freeSize(), free - used);
+
+        EXPECT_TRUE(buffer->hasFreeBlk());
+        EXPECT_EQ(buffer->freeSize(), free);
+        EXPECT_TRUE(buffer->check());
+
+        // 单个数据块的远程释放
+        auto p = buffer->getBufBlk(1000);
+        std::thread([&]() { buffer->release(p); }).join();
+        EXPECT_EQ(buffer->getStatistic().remoteFrees, 3u);
+        EXPECT_EQ(buffer->getBufBlk(1000), p);
+        buffer->release(p);
+    }
+}
+
+// 持续 quietPeriod 未被分配的空闲 chunk 归还系统, 再次读取时为零页
+TEST(DynamicBufferTest, TrimReturnsQuietChunks)
+{
+    Buffer_t buffer(DynamicBuffer::POLICY_FIRST_FIT);
+    time_t now = Clock::update() / 1000;
+
+    auto p = buffer->getBufBlk(3 * CHUNK);
+    ASSERT_NE(p, nullptr);
+    memset(p->buffer, 'x', 3 * CHUNK);
+    char *middle = p->buffer + CHUNK + CHUNK / 2; // 位于第二个 chunk 中
+    buffer->release(p);
+
+    // 未满静默期
+    buffer->trim(now, 10);
+    EXPECT_EQ(*middle, 'x');
+
+    buffer->trim(now + 100, 10);
+    EXPECT_EQ(*middle, 0);
+
+    // 空闲块头部所在的 chunk 不归还
+    EXPECT_TRUE(buffer->check());
+    auto q = buffer->getBufBlk(100);
+    ASSERT_NE(q, nullptr);
+    buffer->release(q);
+}
+
+// 批量分配在缓冲区不足时返回已分配的个数
+TEST(DynamicBufferTest, BatchedAlloc)
+{
+    Buffer_t buffer(DynamicBuffer::POLICY_FIRST_FIT);
+    uint64_t sizes[] = {1000, CAPACITY / 2, CAPACITY / 2, 1000};
+    DynamicBuffer::BufBlk_t *blks[4] = {nullptr};
+    uint32_t count = buffer->getBufBlks(sizes, 4, blks);
+    EXPECT_EQ(count, 2u);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        EXPECT_EQ(blks[i]->dataSize, sizes[i]);
+        buffer->release(blks[i]);
+    }
+    EXPECT_TRUE(buffer->check());
+}
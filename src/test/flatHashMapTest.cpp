@@ -0,0 +1,169 @@
+/**
+ * @file flatHashMapTest.cpp
+ * @author Liu Yu (source@liuyu.com)
+ * @brief Unit tests of utils::FlatHashMap.
+ * @version 1.0
+ * @date 2020-02-26
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include <random>
+#include <unordered_map>
+#include <gtest/gtest.h>
+#include "../utils/flatHashMap.h"
+
+using namespace mapper::utils;
+
+namespace
+{
+
+// 暴露迁移状态
+class Map_t : public FlatHashMap<uint64_t, uint64_t>
+{
+public:
+    inline bool migrating() const { return mpOld != nullptr; }
+    inline uint32_t capacity() const { return mpCur->capacity; }
+};
+
+void expectSame(Map_t &map, std::unordered_map<uint64_t, uint64_t> &expected)
+{
+    ASSERT_EQ(map.size(), expected.size());
+    for (auto &it : expected)
+    {
+        auto pValue = map.find(it.first);
+        ASSERT_NE(pValue, nullptr) << "key: " << it.first;
+        EXPECT_EQ(*pValue, it.second);
+    }
+    size_t count = 0;
+    map.forEach([&](const uint64_t &key, uint64_t &value) {
+        ++count;
+        EXPECT_EQ(expected[key], value);
+    });
+    EXPECT_EQ(count, expected.size());
+}
+
+// 插入直至开始迁移
+void fillUntilMigrating(Map_t &map, std::unordered_map<uint64_t, uint64_t> &expected, uint64_t &next)
+{
+    while (!map.migrating())
+    {
+        map.insert(next, next * 3);
+        expected[next] = next * 3;
+        ++next;
+    }
+}
+
+} // namespace
+
+// 迁移期间删除尚在旧表中的键, 其后查找不到, 且迁移完成后不会复活
+TEST(FlatHashMapTest, EraseDuringMigration)
+{
+    Map_t map;
+    std::unordered_map<uint64_t, uint64_t> expected;
+    uint64_t next = 1;
+    fillUntilMigrating(map, expected, next);
+
+    // 每次删除都会迁移一部分, 从最早插入的键删起, 其中大部分仍在旧表中
+    for (uint64_t key = 1; map.migrating(); ++key)
+    {
+        ASSERT_TRUE(map.erase(key));
+        expected.erase(key);
+        EXPECT_EQ(map.find(key), nullptr);
+        EXPECT_FALSE(map.erase(key));
+    }
+    expectSame(map, expected);
+}
+
+// 迁移期间插入新键、更新旧表中的键
+TEST(FlatHashMapTest, InsertDuringMigration)
+{
+    Map_t map;
+    std::unordered_map<uint64_t, uint64_t> expected;
+    uint64_t next = 1;
+    fillUntilMigrating(map, expected, next);
+    uint32_t capacity = map.capacity();
+
+    for (uint64_t key = 1; map.migrating(); ++key)
+    {
+        // 更新已有的键不增加元素个数
+        map.insert(key, key + 1000000);
+        expected[key] = key + 1000000;
+        map.insert(next, next);
+        expected[next] = next;
+        ++next;
+        ASSERT_EQ(map.size(), expected.size());
+    }
+    EXPECT_EQ(map.capacity(), capacity);
+    expectSame(map, expected);
+}
+
+// 元素个数不变的持续插入/删除 (如连接的建立与关闭) 不会使表无限扩容
+TEST(FlatHashMapTest, ChurnDoesNotGrow)
+{
+    Map_t map;
+    std::unordered_map<uint64_t, uint64_t> expected;
+    uint64_t next = 1;
+    fillUntilMigrating(map, expected, next);
+    while (map.migrating())
+    {
+        map.insert(next, next);
+        expected[next] = next;
+        ++next;
+    }
+    uint32_t capacity = map.capacity();
+
+    // 删除最早的键并插入新键, 元素个数保持不变
+    for (uint64_t oldest = 1; oldest < 100000; ++oldest)
+    {
+        ASSERT_TRUE(map.erase(oldest));
+        expected.erase(oldest);
+        map.insert(next, next);
+        expected[next] = next;
+        ++next;
+    }
+    EXPECT_LE(map.capacity(), capacity * 2);
+    expectSame(map, expected);
+}
+
+// 随机插入/更新/删除, 与 std::unordered_map 对照, 覆盖多次迁移
+TEST(FlatHashMapTest, RandomOperations)
+{
+    Map_t map;
+    std::unordered_map<uint64_t, uint64_t> expected;
+    std::mt19937_64 rand(1);
+    uint32_t migrations = 0;
+    bool migrating = false;
+    for (uint32_t i = 0; i < 200000; ++i)
+    {
+        uint64_t key = rand() % 20000;
+        if (rand() % 3)
+        {
+            map.insert(key, i);
+            expected[key] = i;
+        }
+        else
+        {
+            EXPECT_EQ(map.erase(key), expected.erase(key) == 1);
+        }
+
+        map.migrating() && !migrating && ++migrations;
+        migrating = map.migrating();
+        if (i % 1000 == 0)
+        {
+            auto pValue = map.find(key);
+            auto it = expected.find(key);
+            ASSERT_EQ(pValue != nullptr, it != expected.end());
+            if (pValue)
+            {
+                EXPECT_EQ(*pValue, it->second);
+            }
+        }
+    }
+    EXPECT_GT(migrations, 1u);
+    expectSame(map, expected);
+
+    map.clear();
+    EXPECT_TRUE(map.empty());
+    EXPECT_FALSE(map.migrating());
+}
@@ -0,0 +1,164 @@
+/**
+ * @file slabPoolTest.cpp
+ * @author Liu Yu (source@liuyu.com)
+ * @brief Unit tests of utils::SlabPool.
+ * @version 1.0
+ * @date 2020-03-02
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include <set>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "../utils/slabPool.h"
+
+using namespace mapper::utils;
+
+namespace
+{
+
+// 对象池按类型区分, 各测试使用不同的类型以获得独立的对象池
+template <int N>
+struct Object_t
+{
+    uint64_t value;
+};
+
+struct Cold_t
+{
+    uint64_t value = 0;
+};
+
+} // namespace
+
+TEST(SlabPoolTest, InvalidHandle)
+{
+    typedef SlabPool<Object_t<0>> Pool;
+    EXPECT_EQ(Pool::fromHandle(0), nullptr);
+
+    auto p = Pool::alloc();
+    ASSERT_NE(p, nullptr);
+    EXPECT_NE(Pool::handle(p), 0u);
+    Pool::release(p);
+}
+
+// 对象释放后代数加一, 之前的句柄失效; 同一槽位再次分配得到新的句柄
+TEST(SlabPoolTest, HandleGenerationAfterRelease)
+{
+    typedef SlabPool<Object_t<1>> Pool;
+    auto p = Pool::alloc();
+    ASSERT_NE(p, nullptr);
+    uint64_t h1 = Pool::handle(p);
+    EXPECT_EQ(Pool::fromHandle(h1), p);
+
+    Pool::release(p);
+    EXPECT_EQ(Pool::fromHandle(h1), nullptr);
+
+    // 空闲链表后进先出, 再次分配得到同一槽位
+    auto q = Pool::alloc();
+    ASSERT_EQ(q, p);
+    uint64_t h2 = Pool::handle(q);
+    EXPECT_NE(h2, h1);
+    EXPECT_EQ((uint32_t)h2, (uint32_t)h1); // 序号相同, 代数不同
+    EXPECT_EQ(Pool::fromHandle(h2), q);
+    EXPECT_EQ(Pool::fromHandle(h1), nullptr);
+
+    Pool::release(q);
+    EXPECT_EQ(Pool::fromHandle(h2), nullptr);
+}
+
+// 跨越多组分配, 对象按 cache line 对齐, 句柄与冷数据一一对应
+TEST(SlabPoolTest, HandlesAndColdAcrossSlabs)
+{
+    typedef SlabPool<Object_t<2>, Cold_t> Pool;
+    std::vector<Object_t<2> *> objects;
+    std::set<uint64_t> handles;
+    for (uint64_t i = 0; i < 3000; ++i)
+    {
+        auto p = Pool::alloc();
+        ASSERT_NE(p, nullptr);
+        EXPECT_EQ((uintptr_t)p % 64, 0u);
+        p->value = i;
+        Pool::cold(p)->value = i * 2;
+        objects.push_back(p);
+        EXPECT_TRUE(handles.insert(Pool::handle(p)).second);
+    }
+    EXPECT_GE(Pool::capacity(), 3000u);
+
+    for (auto h : handles)
+    {
+        auto p = Pool::fromHandle(h);
+        ASSERT_NE(p, nullptr);
+        EXPECT_EQ(Pool::cold(p)->value, p->value * 2);
+    }
+
+    for (auto p : objects)
+    {
+        Pool::release(p);
+    }
+    for (auto h : handles)
+    {
+        EXPECT_EQ(Pool::fromHandle(h), nullptr);
+    }
+    EXPECT_EQ(Pool::freeCount(), Pool::capacity());
+}
+
+// 由其他线程释放的对象, 句柄立即失效, 由所属线程在空闲链表用完后回收
+TEST(SlabPoolTest, RemoteRelease)
+{
+    typedef SlabPool<Object_t<3>> Pool;
+    ASSERT_TRUE(Pool::prewarm(1));
+    uint32_t capacity = Pool::capacity();
+
+    std::vector<Object_t<3> *> objects;
+    std::vector<uint64_t> handles;
+    while (Pool::freeCount())
+    {
+        objects.push_back(Pool::alloc());
+        handles.push_back(Pool::handle(objects.back()));
+    }
+
+    std::thread([&]() {
+        for (auto p : objects)
+        {
+            Pool::release(p);
+        }
+    }).join();
+
+    EXPECT_EQ(Pool::freeCount(), 0u);
+    for (auto h : handles)
+    {
+        EXPECT_EQ(Pool::fromHandle(h), nullptr);
+    }
+
+    // 回收远程释放的对象, 不增加新的组
+    auto p = Pool::alloc();
+    EXPECT_NE(p, nullptr);
+    EXPECT_EQ(Pool::capacity(), capacity);
+    EXPECT_EQ(Pool::freeCount(), capacity - 1);
+    Pool::release(p);
+}
+
+// 线程退出后, 其对象池由之后首次使用的线程接管, 句柄仍然有效
+TEST(SlabPoolTest, OrphanPoolAdopted)
+{
+    typedef SlabPool<Object_t<4>> Pool;
+    Object_t<4> *p = nullptr;
+    uint64_t h = 0;
+    std::thread([&]() {
+        p = Pool::alloc();
+        h = Pool::handle(p);
+    }).join();
+
+    EXPECT_EQ(Pool::fromHandle(h), p);
+    auto q = Pool::alloc();
+    ASSERT_NE(q, nullptr);
+    EXPECT_NE(q, p);
+    EXPECT_EQ(Pool::handle(q) >> 24 & 0xff, h >> 24 & 0xff); // 同一对象池
+
+    Pool::release(p);
+    Pool::release(q);
+    EXPECT_EQ(Pool::fromHandle(h), nullptr);
+}
@@ -0,0 +1,162 @@
+/**
+ * @file spscRingTest.cpp
+ * @author Liu Yu (source@liuyu.com)
+ * @brief Unit tests of utils::SpscRing.
+ * @version 1.0
+ * @date 2020-02-24
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "../utils/spscRing.h"
+
+using namespace mapper::utils;
+
+namespace
+{
+
+// 设置起始计数, 用于测试 32 位计数回绕
+class Ring_t : public SpscRing<uint32_t>
+{
+public:
+    explicit Ring_t(uint32_t capacity) : SpscRing<uint32_t>(capacity) {}
+    inline void startAt(uint32_t count)
+    {
+        mHead.store(count);
+        mTail.store(count);
+        mProducerTail = mProducerHead = count;
+    }
+};
+
+} // namespace
+
+TEST(SpscRingTest, CapacityRoundsUpToPowerOfTwo)
+{
+    SpscRing<int> ring(5);
+    EXPECT_EQ(ring.capacity(), 8u);
+
+    for (int i = 0; i < 8; ++i)
+    {
+        EXPECT_TRUE(ring.push(i));
+    }
+    EXPECT_FALSE(ring.push(8));
+
+    // 未发布的数据不可见
+    EXPECT_EQ(ring.consume([](int) {}), 0u);
+    ring.publish();
+    EXPECT_EQ(ring.consume([](int) {}), 8u);
+    EXPECT_TRUE(ring.push(8));
+}
+
+// 下标多次回绕后, 数据仍按写入顺序取出
+TEST(SpscRingTest, WrapAround)
+{
+    SpscRing<uint32_t> ring(4);
+    uint32_t pushed = 0, consumed = 0;
+    for (uint32_t round = 0; round < 1000; ++round)
+    {
+        uint32_t count = round % 4 + 1;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            ASSERT_TRUE(ring.push(pushed++));
+        }
+        ring.publish();
+        ring.consume([&](uint32_t v) { EXPECT_EQ(v, consumed++); });
+        ASSERT_EQ(consumed, pushed);
+    }
+}
+
+// head/tail 越过 UINT32_MAX 时仍能正确判断空/满
+TEST(SpscRingTest, CounterWrapAround)
+{
+    Ring_t ring(4);
+    ring.startAt(UINT32_MAX - 5);
+    uint32_t pushed = 0, consumed = 0;
+    for (uint32_t round = 0; round < 8; ++round)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            ASSERT_TRUE(ring.push(pushed++));
+        }
+        EXPECT_FALSE(ring.push(0));
+        EXPECT_TRUE(ring.publish());
+        EXPECT_EQ(ring.consume([&](uint32_t v) { EXPECT_EQ(v, consumed++); }), 4u);
+        EXPECT_EQ(ring.consume([](uint32_t) {}), 0u);
+    }
+    EXPECT_EQ(consumed, pushed);
+}
+
+// publish() 只在消费者已取空队列时要求唤醒
+TEST(SpscRingTest, PublishReportsEmptyToNonEmpty)
+{
+    SpscRing<int> ring(8);
+    EXPECT_FALSE(ring.publish()); // 无新数据
+
+    ring.push(1);
+    EXPECT_TRUE(ring.publish()); // 空 -> 非空
+    ring.push(2);
+    EXPECT_FALSE(ring.publish()); // 消费者尚未取走之前的数据, 已被唤醒过
+
+    EXPECT_EQ(ring.consume([](int) {}), 2u);
+    ring.push(3);
+    EXPECT_TRUE(ring.publish());
+}
+
+// 消费者取空后进入等待, 生产者按 publish() 的返回值唤醒, 不丢失唤醒
+TEST(SpscRingTest, NoLostWakeup)
+{
+    SpscRing<uint32_t> ring(16);
+    const uint32_t total = 200000;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    uint32_t signals = 0;
+
+    uint32_t received = 0;
+    bool ordered = true;
+    std::thread consumer([&]() {
+        while (received < total)
+        {
+            if (ring.consume([&](uint32_t v) { ordered = ordered && v == received++; }))
+            {
+                continue;
+            }
+
+            // 队列为空, 等待唤醒; 超时说明唤醒丢失
+            std::unique_lock<std::mutex> lk(mutex);
+            if (!cond.wait_for(lk, std::chrono::seconds(5), [&]() { return signals > 0; }))
+            {
+                ADD_FAILURE() << "lost wakeup at " << received;
+                return;
+            }
+            --signals;
+        }
+    });
+
+    for (uint32_t i = 0; i < total;)
+    {
+        // 每批写入数量不定, 批间可能等待消费者
+        uint32_t batch = i % 7 + 1;
+        while (batch-- && i < total && ring.push(i))
+        {
+            ++i;
+        }
+        if (ring.publish())
+        {
+            std::lock_guard<std::mutex> lg(mutex);
+            ++signals;
+            cond.notify_one();
+        }
+        (i % 1024 == 0) && (std::this_thread::yield(), true);
+    }
+
+    consumer.join();
+    EXPECT_EQ(received, total);
+    EXPECT_TRUE(ordered);
+}
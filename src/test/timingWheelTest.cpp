@@ -0,0 +1,162 @@
+/**
+ * @file timingWheelTest.cpp
+ * @author Liu Yu (source@liuyu.com)
+ * @brief Unit tests of utils::TimingWheel.
+ * @version 1.0
+ * @date 2020-03-06
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include <map>
+#include <vector>
+#include <gtest/gtest.h>
+#include "../utils/timingWheel.h"
+
+using namespace mapper::utils;
+
+namespace
+{
+
+struct Timer_t
+{
+    TimingWheel::Entity_t entity;
+    uint64_t fired = 0; // 触发时的时间, 0: 未触发
+};
+
+// 逐 ms 推进至 end, 记录各对象的触发时间
+void runTo(TimingWheel &wheel, uint64_t from, uint64_t end)
+{
+    for (uint64_t now = from; now <= end; ++now)
+    {
+        wheel.expire(now, [&](TimingWheel::Entity_t *p) {
+            auto pTimer = (Timer_t *)p->container;
+            EXPECT_EQ(pTimer->fired, 0u);
+            pTimer->fired = now;
+        });
+    }
+}
+
+} // namespace
+
+// 超时时间恰好落在各层边界 (64^n) 前后的对象, 经逐层下放后在到期的那一刻触发
+TEST(TimingWheelTest, CascadeAtLevelBoundaries)
+{
+    std::vector<uint32_t> timeouts;
+    for (uint64_t span = 64; span <= 64 * 64 * 64; span *= 64)
+    {
+        timeouts.push_back(span - 1);
+        timeouts.push_back(span);
+        timeouts.push_back(span + 1);
+    }
+    timeouts.push_back(1);
+
+    TimingWheel wheel;
+    std::vector<Timer_t> timers(timeouts.size());
+    for (size_t i = 0; i < timers.size(); ++i)
+    {
+        timers[i].entity.init(&timers[i]);
+        wheel.add(0, timeouts[i], &timers[i].entity);
+    }
+    EXPECT_EQ(wheel.size(), timers.size());
+
+    runTo(wheel, 1, 64 * 64 * 64 + 2);
+
+    for (size_t i = 0; i < timers.size(); ++i)
+    {
+        EXPECT_EQ(timers[i].fired, timeouts[i]) << "timeout: " << timeouts[i];
+        EXPECT_FALSE(wheel.inWheel(&timers[i].entity));
+    }
+    EXPECT_EQ(wheel.size(), 0u);
+}
+
+// 从非零时间起, 跨越边界的对象同样准时触发
+TEST(TimingWheelTest, CascadeFromUnalignedStart)
+{
+    TimingWheel wheel;
+    const uint64_t start = 64 * 64 - 3;
+    std::vector<Timer_t> timers(200);
+    for (size_t i = 0; i < timers.size(); ++i)
+    {
+        timers[i].entity.init(&timers[i]);
+        wheel.add(start, 1 + i * 37, &timers[i].entity);
+    }
+
+    runTo(wheel, start, start + 200 * 37 + 1);
+
+    for (size_t i = 0; i < timers.size(); ++i)
+    {
+        EXPECT_EQ(timers[i].fired, start + 1 + i * 37);
+    }
+}
+
+// refresh() 只更新活跃时间, 到期时按新的超时时间重新放入
+TEST(TimingWheelTest, RefreshDefersExpiration)
+{
+    TimingWheel wheel;
+    Timer_t timer;
+    timer.entity.init(&timer);
+    wheel.add(0, 100, &timer.entity);
+
+    runTo(wheel, 1, 90);
+    wheel.refresh(90, &timer.entity);
+    runTo(wheel, 91, 189);
+    EXPECT_EQ(timer.fired, 0u);
+    EXPECT_TRUE(wheel.inWheel(&timer.entity));
+
+    runTo(wheel, 190, 190);
+    EXPECT_EQ(timer.fired, 190u);
+}
+
+// 回调中移除同一槽位中的其他到期对象, 或重新加入自身
+TEST(TimingWheelTest, ModifyInCallback)
+{
+    TimingWheel wheel;
+    Timer_t a, b, c;
+    a.entity.init(&a);
+    b.entity.init(&b);
+    c.entity.init(&c);
+    wheel.add(0, 10, &a.entity);
+    wheel.add(0, 10, &b.entity);
+    wheel.add(0, 10, &c.entity);
+
+    uint32_t count = 0;
+    wheel.expire(10, [&](TimingWheel::Entity_t *p) {
+        ++count;
+        // 首个触发的对象移除其余两个中的一个, 并以新的超时时间重新加入自身
+        if (count == 1)
+        {
+            wheel.erase(p == &a.entity ? &b.entity : &a.entity);
+            wheel.add(10, 5, p);
+        }
+    });
+    EXPECT_EQ(count, 2u);
+    EXPECT_EQ(wheel.size(), 1u);
+
+    count = 0;
+    wheel.expire(15, [&](TimingWheel::Entity_t *) { ++count; });
+    EXPECT_EQ(count, 1u);
+    EXPECT_EQ(wheel.size(), 0u);
+}
+
+// nextExpire() 不晚于最早的到期时间, 且时间轮为空时为 UINT64_MAX
+TEST(TimingWheelTest, NextExpire)
+{
+    TimingWheel wheel;
+    EXPECT_EQ(wheel.nextExpire(), UINT64_MAX);
+
+    Timer_t timer;
+    timer.entity.init(&timer);
+    wheel.add(0, 5000, &timer.entity);
+    uint64_t now = 0;
+    while (!timer.fired)
+    {
+        uint64_t next = wheel.nextExpire();
+        ASSERT_GT(next, now);
+        ASSERT_LE(next, 5000u);
+        now = next;
+        wheel.expire(now, [&](TimingWheel::Entity_t *) { timer.fired = now; });
+    }
+    EXPECT_EQ(timer.fired, 5000u);
+    EXPECT_EQ(wheel.nextExpire(), UINT64_MAX);
+}
@@ -0,0 +1,319 @@
+/**
+ * @file uringPollerTest.cpp
+ * @author Liu Yu (source@liuyu.com)
+ * @brief Unit tests of link::UringPoller: poll emulation, multishot accept,
+ *        provided buffer ring and linked send -> recv.
+ * @version 1.0
+ * @date 2020-03-08
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "../link/endpoint.h"
+#include "../link/uringPoller.h"
+
+using namespace mapper::link;
+
+namespace
+{
+
+class UringPollerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        auto pPoller = Poller::create(Poller::BACKEND_IO_URING, &mCtlCount);
+        ASSERT_NE(pPoller, nullptr);
+        if (pPoller->backend() != Poller::BACKEND_IO_URING)
+        {
+            Poller::release(pPoller);
+            GTEST_SKIP() << "io_uring is not available";
+        }
+        mpPoller = (UringPoller *)pPoller;
+    }
+
+    void TearDown() override
+    {
+        Poller::release(mpPoller);
+        for (auto pe : mEndpoints)
+        {
+            pe->soc > 0 && ::close(pe->soc);
+            Endpoint::releaseEndpoint(pe);
+        }
+        for (auto soc : mSocs)
+        {
+            ::close(soc);
+        }
+    }
+
+    Endpoint_t *endpoint(int soc)
+    {
+        auto pe = Endpoint::getEndpoint(PROTOCOL_TCP, TO_SOUTH, TYPE_NORMAL);
+        pe->soc = soc;
+        mEndpoints.push_back(pe);
+        return pe;
+    }
+
+    // 连接的一对 socket, [0] 由测试直接读写, [1] 作为端点
+    Endpoint_t *pair(int &other, bool nonblock = false)
+    {
+        int socs[2];
+        EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM | (nonblock ? SOCK_NONBLOCK : 0), 0, socs), 0);
+        other = socs[0];
+        mSocs.push_back(other);
+        return endpoint(socs[1]);
+    }
+
+    // 收取完成事件直至 done() 返回 true, 返回期间的就绪事件个数
+    int waitUntil(std::function<bool(const UringPoller::Completion_t &)> done, int timeout = 1000)
+    {
+        epoll_event events[16];
+        int ready = 0;
+        for (int i = 0; i < 50; ++i)
+        {
+            int nRet = mpPoller->wait(events, 16, timeout / 50);
+            EXPECT_GE(nRet, 0);
+            ready += nRet;
+            for (auto &c : mpPoller->completions())
+            {
+                if (done(c))
+                {
+                    return ready;
+                }
+            }
+        }
+        ADD_FAILURE() << "timeout";
+        return ready;
+    }
+
+    void relayThroughBufferRing(bool nonblock)
+    {
+        int client, server;
+        auto south = pair(client, nonblock);
+        auto north = pair(server, nonblock);
+
+        const uint32_t BUFS = 2, SIZE = 16;
+        ASSERT_TRUE(mpPoller->setupBufRing(BUFS));
+        std::vector<std::string> bufs(BUFS, std::string(SIZE, 0));
+        for (uint32_t bid = 0; bid < BUFS; ++bid)
+        {
+            mpPoller->provide(bid, &bufs[bid][0], SIZE);
+        }
+        ASSERT_TRUE(mpPoller->recv(south));
+
+        std::string data;
+        for (int i = 0; i < 10; ++i)
+        {
+            data += "0123456789";
+        }
+        ASSERT_EQ(write(client, data.data(), data.size()), (ssize_t)data.size());
+
+        // 接收的数据经同一缓冲区发出, 发出后归还缓冲区
+        std::string received;
+        waitUntil([&](const UringPoller::Completion_t &c) {
+            EXPECT_EQ(c.pe, c.op == UringPoller::OP_RECV ? south : north);
+            EXPECT_LT(c.bid, BUFS);
+            EXPECT_GT(c.res, 0);
+            if (c.op == UringPoller::OP_RECV)
+            {
+                EXPECT_LE(c.res, (int)SIZE);
+                EXPECT_TRUE(mpPoller->relay(north, c.bid, bufs[c.bid].data(), c.res, south));
+            }
+            else
+            {
+                mpPoller->provide(c.bid, &bufs[c.bid][0], SIZE);
+                char buf[SIZE];
+                ssize_t nRet = read(server, buf, SIZE);
+                nRet > 0 && (received.append(buf, nRet), true);
+            }
+            return received.size() == data.size();
+        });
+        EXPECT_EQ(received, data);
+
+        // 取走缓冲区不归还, 直至缓冲区环为空
+        int recvs = 0;
+        ASSERT_EQ(write(client, data.data(), data.size()), (ssize_t)data.size());
+        waitUntil([&](const UringPoller::Completion_t &c) {
+            if (c.op == UringPoller::OP_RECV && c.res > 0 && ++recvs < 10)
+            {
+                EXPECT_TRUE(mpPoller->recv(south));
+            }
+            return c.res == -ENOBUFS;
+        });
+        EXPECT_EQ(recvs, (int)BUFS);
+    }
+
+    std::atomic<uint64_t> mCtlCount{0};
+    UringPoller *mpPoller = nullptr;
+    std::vector<Endpoint_t *> mEndpoints;
+    std::vector<int> mSocs;
+};
+
+} // namespace
+
+// poll 请求触发后重新注册, 数据未读完时每次 wait() 都返回 EPOLLIN
+TEST_F(UringPollerTest, PollIsLevelTriggered)
+{
+    int other;
+    auto pe = pair(other);
+    ASSERT_TRUE(mpPoller->add(pe, EPOLLIN));
+    ASSERT_EQ(write(other, "x", 1), 1);
+
+    epoll_event events[4];
+    for (int i = 0; i < 3; ++i)
+    {
+        ASSERT_EQ(mpPoller->wait(events, 4, 1000), 1);
+        EXPECT_EQ(events[0].data.ptr, pe);
+        EXPECT_TRUE(events[0].events & EPOLLIN);
+    }
+
+    // 修改为只写后不再返回 EPOLLIN
+    ASSERT_TRUE(mpPoller->modify(pe, EPOLLOUT));
+    ASSERT_EQ(mpPoller->wait(events, 4, 1000), 1);
+    EXPECT_EQ(events[0].events & (EPOLLIN | EPOLLOUT), (uint32_t)EPOLLOUT);
+}
+
+// 移除后, 已位于完成队列中的事件被丢弃; 重新加入的端点不会收到旧请求的事件
+TEST_F(UringPollerTest, RemoveDropsPendingEvents)
+{
+    int other;
+    auto pe = pair(other);
+    ASSERT_TRUE(mpPoller->add(pe, EPOLLIN));
+    ASSERT_EQ(mpPoller->wait(nullptr, 0, 0), 0); // 提交 poll 请求
+    ASSERT_EQ(write(other, "x", 1), 1);          // 完成事件进入完成队列
+
+    ASSERT_TRUE(mpPoller->remove(pe));
+    EXPECT_FALSE(mpPoller->remove(pe));
+    epoll_event events[4];
+    EXPECT_EQ(mpPoller->wait(events, 4, 100), 0);
+
+    ASSERT_TRUE(mpPoller->add(pe, EPOLLIN));
+    ASSERT_EQ(mpPoller->wait(events, 4, 1000), 1);
+    EXPECT_EQ(events[0].data.ptr, pe);
+    ASSERT_TRUE(mpPoller->remove(pe));
+}
+
+// 一个 multishot accept 请求接受多个连接
+TEST_F(UringPollerTest, MultishotAccept)
+{
+    int soc = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    ASSERT_EQ(bind(soc, (sockaddr *)&addr, len), 0);
+    ASSERT_EQ(listen(soc, 16), 0);
+    ASSERT_EQ(getsockname(soc, (sockaddr *)&addr, &len), 0);
+    auto pse = endpoint(soc);
+    ASSERT_TRUE(mpPoller->accept(pse));
+
+    const int CLIENTS = 3;
+    for (int i = 0; i < CLIENTS; ++i)
+    {
+        int client = socket(AF_INET, SOCK_STREAM, 0);
+        mSocs.push_back(client);
+        ASSERT_EQ(::connect(client, (sockaddr *)&addr, sizeof(addr)), 0);
+    }
+
+    int accepted = 0;
+    waitUntil([&](const UringPoller::Completion_t &c) {
+        EXPECT_EQ(c.op, UringPoller::OP_ACCEPT);
+        EXPECT_EQ(c.pe, pse);
+        EXPECT_TRUE(c.more);
+        EXPECT_GT(c.res, 0);
+        c.res > 0 && (mSocs.push_back(c.res), true);
+        return ++accepted == CLIENTS;
+    });
+    EXPECT_EQ(accepted, CLIENTS);
+
+    // 撤销后以 -ECANCELED 结束
+    ASSERT_TRUE(mpPoller->remove(pse));
+    waitUntil([&](const UringPoller::Completion_t &c) {
+        EXPECT_FALSE(c.more);
+        return c.res == -ECANCELED;
+    });
+}
+
+// 经缓冲区环接收, 每个缓冲区发出后归还, 数据按序转发; 缓冲区用完时以 -ENOBUFS 完成
+TEST_F(UringPollerTest, RelayThroughBufferRing)
+{
+    relayThroughBufferRing(false);
+}
+
+// io_uring 自行等待非阻塞 socket 就绪, 不返回 -EAGAIN
+TEST_F(UringPollerTest, RelayOnNonBlockingSockets)
+{
+    relayThroughBufferRing(true);
+}
+
+// 发送失败时, 链接在其后的接收被撤销
+TEST_F(UringPollerTest, SendFailureCancelsLinkedRecv)
+{
+    int client, server;
+    auto south = pair(client);
+    auto north = pair(server);
+    ASSERT_TRUE(mpPoller->setupBufRing(1));
+    char buf[16] = "hello";
+    ::close(server);
+    mSocs.pop_back();
+
+    ASSERT_TRUE(mpPoller->relay(north, 0, buf, 5, south));
+    int sendRes = 0, recvRes = 0;
+    waitUntil([&](const UringPoller::Completion_t &c) {
+        (c.op == UringPoller::OP_SEND ? sendRes : recvRes) = c.res;
+        if (c.op == UringPoller::OP_SEND)
+        {
+            EXPECT_EQ(c.bid, 0u);
+        }
+        return sendRes && recvRes;
+    });
+    EXPECT_EQ(sendRes, -EPIPE);
+    EXPECT_EQ(recvRes, -ECANCELED);
+}
+
+// 端点移除并释放后, 其请求的完成事件不再指向端点, 但仍带有缓冲区序号
+TEST_F(UringPollerTest, RemoveCancelsRequestsOfReleasedEndpoint)
+{
+    int client, server;
+    auto south = pair(client);
+    auto north = pair(server);
+    ASSERT_TRUE(mpPoller->setupBufRing(1));
+
+    // 对端不读取, 大块数据的发送停留在内核中
+    std::string data(8 * 1024 * 1024, 'x');
+    ASSERT_TRUE(mpPoller->relay(north, 0, data.data(), data.size(), south));
+    ASSERT_EQ(mpPoller->wait(nullptr, 0, 0), 0);
+
+    ASSERT_TRUE(mpPoller->remove(north));
+    ASSERT_TRUE(mpPoller->remove(south));
+    for (auto pe : {north, south})
+    {
+        ::close(pe->soc);
+        pe->soc = 0;
+        Endpoint::releaseEndpoint(pe);
+    }
+    mEndpoints.clear();
+
+    bool sent = false, received = false;
+    waitUntil([&](const UringPoller::Completion_t &c) {
+        EXPECT_EQ(c.pe, nullptr);
+        EXPECT_LT(c.res, (int)data.size());
+        if (c.op == UringPoller::OP_SEND)
+        {
+            EXPECT_EQ(c.bid, 0u);
+            sent = true;
+        }
+        c.op == UringPoller::OP_RECV && (received = true);
+        return sent && received;
+    });
+}
@@ -0,0 +1,56 @@
+/**
+ * @file clock.h
+ * @author Liu Yu (source@liuyu.com)
+ * @brief Per-thread cached monotonic clock.
+ * @version 1.0
+ * @date 2020-03-09
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef __MAPPER_UTILS_CLOCK_H__
+#define __MAPPER_UTILS_CLOCK_H__
+
+#include <stdint.h>
+#include <time.h>
+
+namespace mapper
+{
+namespace utils
+{
+
+/**
+ * 按线程缓存的单调时钟:
+ *
+ * - 事件循环在每次 epoll_wait 返回后调用 update() 读取一次 CLOCK_MONOTONIC_COARSE,
+ *   之后本线程中的超时、统计等均读取缓存值, 不再调用 time()
+ * - 不受系统时间调整 (如 NTP) 影响, 精度为一个时钟节拍 (通常 1~4ms)
+ * - 起点为系统启动时刻, 只可用于计算时间间隔
+ */
+class Clock
+{
+public:
+    // 读取单调时钟并更新当前线程的缓存, 返回 ms
+    static inline uint64_t update()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return cache() = (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    }
+
+    // 当前线程最近一次 update() 时的时间
+    static inline uint64_t ms() { return cache(); }
+    static inline time_t seconds() { return (time_t)(cache() / 1000); }
+
+protected:
+    static inline uint64_t &cache()
+    {
+        static thread_local uint64_t now = 0;
+        return now;
+    }
+};
+
+} // namespace utils
+} // namespace mapper
+
+#endif // __MAPPER_UTILS_CLOCK_H__
@@ -0,0 +1,351 @@
+/**
+ * @file flatHashMap.h
+ * @author Liu Yu (source@liuyu.com)
+ * @brief Open-addressing hash map with incremental resizing.
+ * @version 1.0
+ * @date 2020-02-26
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef __MAPPER_UTILS_FLATHASHMAP_H__
+#define __MAPPER_UTILS_FLATHASHMAP_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <functional>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+namespace mapper
+{
+namespace utils
+{
+
+/**
+ * 开放寻址哈希表:
+ *
+ * - 每个槽位对应 1 字节控制信息 (空/已删除/哈希值低 7 位), 以 16 个槽位为一组探测,
+ *   支持 SSE2 时一次比较整组控制信息, 只有控制信息匹配的槽位才比较键值
+ * - 扩容时新建两倍大小的表, 旧表中的数据在之后每次插入/删除时迁移一部分,
+ *   迁移期间查找同时检查新旧两张表, 避免一次性 rehash 带来的延迟
+ * - 键和值需可默认构造、可复制
+ */
+template <typename K, typename V, typename Hash = std::hash<K>, typename Equal = std::equal_to<K>>
+class FlatHashMap
+{
+protected:
+    static const uint32_t GROUP_SIZE = 16;
+    static const uint32_t MIN_CAPACITY = GROUP_SIZE;
+    static const uint32_t MIGRATE_STEP = 2 * GROUP_SIZE; // 每次插入/删除时迁移的槽位数
+
+    static const int8_t CTRL_EMPTY = -128;  // 0x80
+    static const int8_t CTRL_DELETED = -2;  // 0xFE
+    // 0x00 ~ 0x7F: 已使用, 存放哈希值的低 7 位
+
+    struct Slot_t
+    {
+        K key;
+        V value;
+    };
+
+    struct Table_t
+    {
+        int8_t *ctrl;
+        Slot_t *slots;
+        uint32_t capacity; // 2 的幂, 且不小于 GROUP_SIZE
+        uint32_t size;
+        uint32_t deleted;
+
+        inline void init(uint32_t _capacity)
+        {
+            capacity = _capacity;
+            ctrl = new int8_t[capacity];
+            memset(ctrl, CTRL_EMPTY, capacity);
+            slots = new Slot_t[capacity];
+            size = 0;
+            deleted = 0;
+        }
+        inline void release()
+        {
+            delete[] ctrl;
+            delete[] slots;
+            ctrl = nullptr;
+            slots = nullptr;
+            capacity = size = deleted = 0;
+        }
+    };
+
+public:
+    explicit FlatHashMap(uint32_t capacity = MIN_CAPACITY) : mpOld(nullptr), mMigratePos(0)
+    {
+        uint32_t cap = MIN_CAPACITY;
+        while (cap < capacity)
+        {
+            cap <<= 1;
+        }
+        mTables[0].init(cap);
+        mTables[1].ctrl = nullptr;
+        mTables[1].slots = nullptr;
+        mTables[1].capacity = mTables[1].size = mTables[1].deleted = 0;
+        mpCur = &mTables[0];
+    }
+    ~FlatHashMap()
+    {
+        mTables[0].release();
+        mTables[1].release();
+    }
+
+    FlatHashMap(const FlatHashMap &) = delete;
+    FlatHashMap &operator=(const FlatHashMap &) = delete;
+
+    inline size_t size() const { return mpCur->size + (mpOld ? mpOld->size : 0); }
+    inline bool empty() const { return size() == 0; }
+
+    // 返回值的地址, 不存在时返回 nullptr
+    V *find(const K &key)
+    {
+        uint64_t hash = hashOf(key);
+        int32_t pos = findIn(mpCur, key, hash);
+        if (pos >= 0)
+        {
+            return &mpCur->slots[pos].value;
+        }
+        if (mpOld && (pos = findIn(mpOld, key, hash)) >= 0)
+        {
+            return &mpOld->slots[pos].value;
+        }
+        return nullptr;
+    }
+
+    // 插入或更新
+    void insert(const K &key, const V &value)
+    {
+        uint64_t hash = hashOf(key);
+        int32_t pos = findIn(mpCur, key, hash);
+        if (pos >= 0)
+        {
+            mpCur->slots[pos].value = value;
+            return;
+        }
+        if (mpOld && (pos = findIn(mpOld, key, hash)) >= 0)
+        {
+            // 迁移中: 直接更新旧表中的值, 随迁移进入新表
+            mpOld->slots[pos].value = value;
+            migrate();
+            return;
+        }
+
+        reserveOne();
+        insertNew(mpCur, key, value, hash);
+        migrate();
+    }
+
+    bool erase(const K &key)
+    {
+        uint64_t hash = hashOf(key);
+        bool erased = eraseIn(mpCur, key, hash) || (mpOld && eraseIn(mpOld, key, hash));
+        migrate();
+        return erased;
+    }
+
+    void clear()
+    {
+        finishMigrate();
+        memset(mpCur->ctrl, CTRL_EMPTY, mpCur->capacity);
+        mpCur->size = 0;
+        mpCur->deleted = 0;
+    }
+
+    // f(const K &key, V &value)
+    template <typename F>
+    void forEach(F &&f)
+    {
+        Table_t *tables[2] = {mpCur, mpOld};
+        for (auto pTable : tables)
+        {
+            for (uint32_t i = 0; pTable && i < pTable->capacity; ++i)
+            {
+                if (pTable->ctrl[i] >= 0)
+                {
+                    f((const K &)pTable->slots[i].key, pTable->slots[i].value);
+                }
+            }
+        }
+    }
+
+protected:
+    static inline uint64_t hashOf(const K &key)
+    {
+        // 对用户哈希值再做一次混合 (splitmix64), 使 std::hash 等恒等哈希的低位也足够分散
+        uint64_t h = (uint64_t)Hash()(key);
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return h;
+    }
+    static inline int8_t h2Of(uint64_t hash) { return (int8_t)(hash & 0x7f); }
+    static inline uint32_t h1Of(uint64_t hash) { return (uint32_t)(hash >> 7); }
+
+    // bit i 置位表示组内第 i 个控制字节等于 value
+    static inline uint32_t matchGroup(const int8_t *group, int8_t value)
+    {
+#ifdef __SSE2__
+        __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+        return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value)));
+#else
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < GROUP_SIZE; ++i)
+        {
+            mask |= (uint32_t)(group[i] == value) << i;
+        }
+        return mask;
+#endif // __SSE2__
+    }
+    // bit i 置位表示组内第 i 个槽位为空或已删除 (控制字节最高位为 1)
+    static inline uint32_t matchFree(const int8_t *group)
+    {
+#ifdef __SSE2__
+        return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+#else
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < GROUP_SIZE; ++i)
+        {
+            mask |= (uint32_t)(group[i] < 0) << i;
+        }
+        return mask;
+#endif // __SSE2__
+    }
+
+    // 以组为单位三角探测, 组数为 2 的幂时可遍历所有组
+    int32_t findIn(Table_t *pTable, const K &key, uint64_t hash)
+    {
+        uint32_t groupMask = pTable->capacity / GROUP_SIZE - 1;
+        uint32_t group = h1Of(hash) & groupMask;
+        int8_t h2 = h2Of(hash);
+        for (uint32_t probe = 1; probe <= groupMask + 1; ++probe)
+        {
+            const int8_t *ctrl = pTable->ctrl + group * GROUP_SIZE;
+            for (uint32_t mask = matchGroup(ctrl, h2); mask; mask &= mask - 1)
+            {
+                uint32_t pos = group * GROUP_SIZE + __builtin_ctz(mask);
+                if (Equal()(pTable->slots[pos].key, key))
+                {
+                    return (int32_t)pos;
+                }
+            }
+            if (matchGroup(ctrl, CTRL_EMPTY))
+            {
+                // 探测链在空槽位处结束
+                return -1;
+            }
+            group = (group + probe) & groupMask;
+        }
+        return -1;
+    }
+
+    void insertNew(Table_t *pTable, const K &key, const V &value, uint64_t hash)
+    {
+        uint32_t groupMask = pTable->capacity / GROUP_SIZE - 1;
+        uint32_t group = h1Of(hash) & groupMask;
+        for (uint32_t probe = 1;; ++probe)
+        {
+            uint32_t mask = matchFree(pTable->ctrl + group * GROUP_SIZE);
+            if (mask)
+            {
+                uint32_t pos = group * GROUP_SIZE + __builtin_ctz(mask);
+                (pTable->ctrl[pos] == CTRL_DELETED) && (--pTable->deleted, true);
+                pTable->ctrl[pos] = h2Of(hash);
+                pTable->slots[pos].key = key;
+                pTable->slots[pos].value = value;
+                ++pTable->size;
+                return;
+            }
+            group = (group + probe) & groupMask;
+        }
+    }
+
+    bool eraseIn(Table_t *pTable, const K &key, uint64_t hash)
+    {
+        int32_t pos = findIn(pTable, key, hash);
+        if (pos < 0)
+        {
+            return false;
+        }
+
+        // 所在组中仍有空槽位时, 探测链不会经过此组, 可直接置为空
+        const int8_t *group = pTable->ctrl + (pos / GROUP_SIZE) * GROUP_SIZE;
+        if (matchGroup(group, CTRL_EMPTY))
+        {
+            pTable->ctrl[pos] = CTRL_EMPTY;
+        }
+        else
+        {
+            pTable->ctrl[pos] = CTRL_DELETED;
+            ++pTable->deleted;
+        }
+        --pTable->size;
+
+        return true;
+    }
+
+    // 保证当前表可以再插入一个元素 (负载不超过 7/8), 否则开始迁移至新表
+    void reserveOne()
+    {
+        if ((mpCur->size + mpCur->deleted + 1) * 8 <= mpCur->capacity * 7)
+        {
+            return;
+        }
+
+        // 上一次迁移尚未完成时 (正常情况下不会发生), 先完成之
+        finishMigrate();
+
+        // 有效数据不足一半时, 只清理已删除槽位, 不扩容
+        uint32_t capacity = mpCur->size * 2 < mpCur->capacity ? mpCur->capacity : mpCur->capacity * 2;
+
+        mpOld = mpCur;
+        mpCur = (mpCur == &mTables[0]) ? &mTables[1] : &mTables[0];
+        mpCur->init(capacity);
+        mMigratePos = 0;
+    }
+
+    void migrate(uint32_t count = MIGRATE_STEP)
+    {
+        if (!mpOld)
+        {
+            return;
+        }
+
+        for (uint32_t end = mMigratePos + count; mMigratePos < mpOld->capacity && mMigratePos < end; ++mMigratePos)
+        {
+            if (mpOld->ctrl[mMigratePos] >= 0)
+            {
+                auto &slot = mpOld->slots[mMigratePos];
+                insertNew(mpCur, slot.key, slot.value, hashOf(slot.key));
+                mpOld->ctrl[mMigratePos] = CTRL_DELETED;
+                --mpOld->size;
+            }
+        }
+
+        if (mMigratePos >= mpOld->capacity)
+        {
+            mpOld->release();
+            mpOld = nullptr;
+        }
+    }
+
+    inline void finishMigrate() { mpOld && (migrate(mpOld->capacity), true); }
+
+    Table_t mTables[2];
+    Table_t *mpCur;
+    Table_t *mpOld; // 迁移中的旧表
+    uint32_t mMigratePos;
+};
+
+} // namespace utils
+} // namespace mapper
+
+#endif // __MAPPER_UTILS_FLATHASHMAP_H__
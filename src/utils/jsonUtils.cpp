@@ -132,6 +132,15 @@ uint64_t JsonUtils::getAsUint64(Document &doc, string path, uint64_t defaultValu
                  : defaultValue;
 }
 
+double JsonUtils::getAsDouble(Document &doc, string path, double defaultValue)
+{
+    auto value = Pointer(path.c_str()).Get(doc);
+    return value ? (value->IsNumber()
+                        ? value->GetDouble()
+                        : defaultValue)
+                 : defaultValue;
+}
+
 Value *JsonUtils::getObj(Value *value, string path)
 {
     return Pointer(path.c_str()).Get(*value);
@@ -0,0 +1,354 @@
+/**
+ * @file slabPool.h
+ * @author Liu Yu (source@liuyu.com)
+ * @brief Per-thread slab object pool with index handles.
+ * @version 1.0
+ * @date 2020-03-02
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef __MAPPER_UTILS_SLABPOOL_H__
+#define __MAPPER_UTILS_SLABPOOL_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <new>
+
+namespace mapper
+{
+namespace utils
+{
+
+// 不小于 n 的最小的 2 的幂
+constexpr uint64_t roundUpPow2(uint64_t n, uint64_t p = 1) { return p >= n ? p : roundUpPow2(n, p << 1); }
+
+// 不需要冷数据表时的占位类型
+struct SlabNoCold_t
+{
+};
+
+/**
+ * 按线程划分的对象池:
+ *
+ * - 每个线程首次使用时获得一个对象池, 对象以 SLAB_SIZE 个槽位为一组连续分配, 直至进程退出才释放,
+ *   线程退出后其对象池由之后首次使用的线程接管
+ * - 对象以 32 位句柄 (池编号 + 池内序号) 加 32 位代数寻址, 对象每次释放时代数加一,
+ *   handle() 得到的 64 位句柄在对象释放后经 fromHandle() 解析为 nullptr
+ * - 由其他线程释放的对象经无锁链表归还, 由所属线程于下一次分配时回收
+ * - 各对象按 cache line 对齐且紧密排列, 槽位中只存放对象本身; 代数、空闲链表等管理数据,
+ *   以及每个对象的冷数据 C (见 cold()) 存放于各组的平行数组中
+ * - 每组按其大小对齐, 首个槽位存放组头部, 由对象地址即可定位所在组
+ * - T 及 C 需可默认构造, 且对象的初始化由使用者负责
+ */
+template <typename T, typename C = SlabNoCold_t>
+class SlabPool
+{
+protected:
+    static const uint32_t INDEX_BITS = 24;                    // 句柄中池内序号的位数
+    static const uint32_t INDEX_MASK = (1 << INDEX_BITS) - 1;
+    static const uint32_t MAX_POOLS = 1 << (32 - INDEX_BITS); // 对象池个数上限
+    static const uint32_t SLAB_SIZE = 1 << 10;                // 每组槽位个数, 含存放组头部的首个槽位
+    static const uint32_t MAX_SLABS = (INDEX_MASK + 1) / SLAB_SIZE;
+    static const uint32_t CACHE_LINE_SIZE = 64;
+
+    struct alignas(CACHE_LINE_SIZE) Slot_t
+    {
+        T object;
+    };
+
+    struct Meta_t
+    {
+        Slot_t *nextFree;
+        std::atomic<uint32_t> gen;
+    };
+
+    // 组头部, 位于组的首个槽位
+    struct Header_t
+    {
+        SlabPool *pool;
+        uint32_t base; // 组内首个槽位的池内序号
+        Meta_t *metas;
+        C *colds;
+    };
+    static_assert(sizeof(Header_t) <= sizeof(Slot_t), "slab header exceeds a slot");
+
+    static const uint64_t SLAB_ALIGN = roundUpPow2(sizeof(Slot_t) * SLAB_SIZE);
+
+    // 线程退出时交出其对象池
+    struct Holder_t
+    {
+        SlabPool *pool = nullptr;
+        ~Holder_t() { pool && (abandon(pool), true); }
+    };
+
+    // 进程退出时释放全部对象池
+    struct Registry_t
+    {
+        std::mutex mutex;
+        std::atomic<SlabPool *> pools[MAX_POOLS];
+        uint32_t poolCount = 0;
+        std::list<SlabPool *> orphans;
+
+        Registry_t()
+        {
+            for (auto &pool : pools)
+            {
+                pool.store(nullptr);
+            }
+        }
+        ~Registry_t()
+        {
+            for (uint32_t i = 0; i < poolCount; ++i)
+            {
+                delete pools[i].load();
+            }
+        }
+    };
+
+    explicit SlabPool(uint32_t id) : mId(id), mSlabCount(0), mFreeList(nullptr), mFreeCount(0)
+    {
+        for (auto &slab : mSlabs)
+        {
+            slab.store(nullptr);
+        }
+        mRemoteFreeList.store(nullptr);
+    }
+    ~SlabPool()
+    {
+        for (uint32_t i = 0; i < mSlabCount; ++i)
+        {
+            auto pSlab = mSlabs[i].load();
+            auto pHeader = (Header_t *)pSlab;
+            for (uint32_t j = 1; j < SLAB_SIZE; ++j)
+            {
+                pSlab[j].~Slot_t();
+            }
+            delete[] pHeader->metas;
+            delete[] pHeader->colds;
+            pHeader->~Header_t();
+            free(pSlab);
+        }
+    }
+
+    SlabPool(const SlabPool &) = delete;
+    SlabPool &operator=(const SlabPool &) = delete;
+
+public:
+    // 从当前线程的对象池中分配, 对象池已达上限时返回 nullptr
+    static T *alloc()
+    {
+        auto pPool = local();
+        return pPool ? pPool->allocLocal() : nullptr;
+    }
+
+    // 可由任意线程释放
+    static void release(T *p)
+    {
+        auto pSlot = (Slot_t *)p;
+        auto pHeader = header(pSlot);
+        pHeader->metas[pSlot - (Slot_t *)pHeader].gen.fetch_add(1, std::memory_order_relaxed);
+        if (pHeader->pool == tHolder.pool)
+        {
+            pHeader->pool->pushFree(pSlot);
+        }
+        else
+        {
+            pHeader->pool->pushRemote(pSlot);
+        }
+    }
+
+    // 当前线程的对象池预先分配至至少 count 个对象
+    static bool prewarm(uint32_t count)
+    {
+        auto pPool = local();
+        while (pPool && pPool->mSlabCount * (SLAB_SIZE - 1) < count)
+        {
+            if (!pPool->grow())
+            {
+                return false;
+            }
+        }
+        return pPool != nullptr;
+    }
+
+    static inline uint64_t handle(T *p)
+    {
+        auto pSlot = (Slot_t *)p;
+        auto pHeader = header(pSlot);
+        uint32_t i = pSlot - (Slot_t *)pHeader;
+        return ((uint64_t)pHeader->metas[i].gen.load(std::memory_order_relaxed) << 32) |
+               ((uint64_t)pHeader->pool->mId << INDEX_BITS) |
+               (pHeader->base + i);
+    }
+
+    // 对象已释放 (代数不符) 时返回 nullptr; 组头部所在槽位不对应任何对象, 因此句柄 0 总是无效
+    static inline T *fromHandle(uint64_t h)
+    {
+        auto pPool = registry().pools[(uint32_t)h >> INDEX_BITS].load(std::memory_order_acquire);
+        uint32_t index = (uint32_t)h & INDEX_MASK;
+        uint32_t i = index % SLAB_SIZE;
+        Slot_t *pSlab;
+        if (!pPool || !i || !(pSlab = pPool->mSlabs[index / SLAB_SIZE].load(std::memory_order_acquire)))
+        {
+            return nullptr;
+        }
+        auto pHeader = (Header_t *)pSlab;
+        return pHeader->metas[i].gen.load(std::memory_order_relaxed) == (uint32_t)(h >> 32) ? &pSlab[i].object : nullptr;
+    }
+
+    // 对象的冷数据, 与对象同生命周期, 初始化由使用者负责
+    static inline C *cold(const T *p)
+    {
+        auto pSlot = (Slot_t *)p;
+        auto pHeader = header(pSlot);
+        return &pHeader->colds[pSlot - (Slot_t *)pHeader];
+    }
+
+    // 当前线程对象池的容量及空闲对象个数 (不含尚未回收的远程释放对象)
+    static inline uint32_t capacity() { return tHolder.pool ? tHolder.pool->mSlabCount * (SLAB_SIZE - 1) : 0; }
+    static inline uint32_t freeCount() { return tHolder.pool ? tHolder.pool->mFreeCount : 0; }
+
+protected:
+    // 以局部静态变量保证先于使用构造, 且晚于各线程的 Holder_t 析构
+    static inline Registry_t &registry()
+    {
+        static Registry_t registry;
+        return registry;
+    }
+
+    static inline Header_t *header(Slot_t *pSlot) { return (Header_t *)((uintptr_t)pSlot & ~(uintptr_t)(SLAB_ALIGN - 1)); }
+    static inline Meta_t &meta(Slot_t *pSlot)
+    {
+        auto pHeader = header(pSlot);
+        return pHeader->metas[pSlot - (Slot_t *)pHeader];
+    }
+
+    static SlabPool *local()
+    {
+        if (tHolder.pool)
+        {
+            return tHolder.pool;
+        }
+
+        auto &reg = registry();
+        std::lock_guard<std::mutex> lg(reg.mutex);
+        if (!reg.orphans.empty())
+        {
+            // 接管已退出线程的对象池
+            tHolder.pool = reg.orphans.front();
+            reg.orphans.pop_front();
+        }
+        else if (reg.poolCount < MAX_POOLS)
+        {
+            tHolder.pool = new SlabPool(reg.poolCount);
+            reg.pools[reg.poolCount++].store(tHolder.pool, std::memory_order_release);
+        }
+
+        return tHolder.pool;
+    }
+
+    static void abandon(SlabPool *pPool)
+    {
+        auto &reg = registry();
+        std::lock_guard<std::mutex> lg(reg.mutex);
+        reg.orphans.push_back(pPool);
+    }
+
+    T *allocLocal()
+    {
+        if (!mFreeList)
+        {
+            reclaim();
+            if (!mFreeList && !grow())
+            {
+                return nullptr;
+            }
+        }
+
+        auto pSlot = mFreeList;
+        mFreeList = meta(pSlot).nextFree;
+        --mFreeCount;
+
+        return &pSlot->object;
+    }
+
+    bool grow()
+    {
+        if (mSlabCount == MAX_SLABS)
+        {
+            return false;
+        }
+
+        // 按组的大小对齐, 对象地址向下对齐即得组头部
+        void *p = nullptr;
+        if (posix_memalign(&p, SLAB_ALIGN, sizeof(Slot_t) * SLAB_SIZE))
+        {
+            return false;
+        }
+        auto pSlab = (Slot_t *)p;
+        auto pHeader = new (p) Header_t();
+        pHeader->pool = this;
+        pHeader->base = mSlabCount * SLAB_SIZE;
+        pHeader->metas = new Meta_t[SLAB_SIZE];
+        pHeader->colds = new C[SLAB_SIZE]();
+        for (uint32_t i = SLAB_SIZE; i-- > 1;)
+        {
+            new (&pSlab[i]) Slot_t();
+            pHeader->metas[i].gen.store(0, std::memory_order_relaxed);
+            pushFree(&pSlab[i]);
+        }
+        mSlabs[mSlabCount++].store(pSlab, std::memory_order_release);
+
+        return true;
+    }
+
+    inline void pushFree(Slot_t *pSlot)
+    {
+        meta(pSlot).nextFree = mFreeList;
+        mFreeList = pSlot;
+        ++mFreeCount;
+    }
+
+    void pushRemote(Slot_t *pSlot)
+    {
+        auto &m = meta(pSlot);
+        auto head = mRemoteFreeList.load(std::memory_order_relaxed);
+        do
+        {
+            m.nextFree = head;
+        } while (!mRemoteFreeList.compare_exchange_weak(head, pSlot,
+                                                        std::memory_order_release,
+                                                        std::memory_order_relaxed));
+    }
+
+    void reclaim()
+    {
+        for (auto pSlot = mRemoteFreeList.exchange(nullptr, std::memory_order_acquire); pSlot;)
+        {
+            auto next = meta(pSlot).nextFree;
+            pushFree(pSlot);
+            pSlot = next;
+        }
+    }
+
+    static thread_local Holder_t tHolder;
+
+    uint32_t mId;
+    std::atomic<Slot_t *> mSlabs[MAX_SLABS];
+    uint32_t mSlabCount;
+    Slot_t *mFreeList; // owner only
+    uint32_t mFreeCount;
+    std::atomic<Slot_t *> mRemoteFreeList;
+};
+
+template <typename T, typename C>
+thread_local typename SlabPool<T, C>::Holder_t SlabPool<T, C>::tHolder;
+
+} // namespace utils
+} // namespace mapper
+
+#endif // __MAPPER_UTILS_SLABPOOL_H__
@@ -0,0 +1,128 @@
+/**
+ * @file spscRing.h
+ * @author Liu Yu (source@liuyu.com)
+ * @brief Bounded lock-free single-producer/single-consumer ring.
+ * @version 1.0
+ * @date 2020-02-24
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef __MAPPER_UTILS_SPSCRING_H__
+#define __MAPPER_UTILS_SPSCRING_H__
+
+#include <stdint.h>
+#include <atomic>
+
+namespace mapper
+{
+namespace utils
+{
+
+/**
+ * 生产者以 push() 写入一批数据后调用 publish() 一次性发布;
+ * publish() 返回 true 表示发布前消费者已取空队列 (可能已进入等待), 需要唤醒消费者。
+ *
+ * publish() 中的 tail 写入/head 读取与 consume() 中的 head 写入/tail 读取均为 seq_cst,
+ * 保证两者至少有一方观察到对方: 要么生产者发出唤醒, 要么消费者取走新发布的数据。
+ */
+template <typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(uint32_t capacity)
+    {
+        mCapacity = 1;
+        while (mCapacity < capacity)
+        {
+            mCapacity <<= 1;
+        }
+        mMask = mCapacity - 1;
+        mItems = new T[mCapacity];
+
+        mHead.store(0);
+        mTail.store(0);
+        mProducerTail = 0;
+        mProducerHead = 0;
+    }
+    ~SpscRing() { delete[] mItems; }
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    // producer: 写入但不发布, 队列满时返回 false
+    inline bool push(const T &item)
+    {
+        if (mProducerTail - mProducerHead == mCapacity)
+        {
+            mProducerHead = mHead.load(std::memory_order_acquire);
+            if (mProducerTail - mProducerHead == mCapacity)
+            {
+                return false;
+            }
+        }
+
+        mItems[mProducerTail & mMask] = item;
+        ++mProducerTail;
+
+        return true;
+    }
+
+    // producer: 发布已写入的数据, 返回是否需要唤醒消费者
+    inline bool publish()
+    {
+        uint32_t prevTail = mTail.load(std::memory_order_relaxed);
+        if (prevTail == mProducerTail)
+        {
+            return false;
+        }
+
+        mTail.store(mProducerTail, std::memory_order_seq_cst);
+        return mHead.load(std::memory_order_seq_cst) == prevTail;
+    }
+
+    // consumer: 取出全部已发布的数据, 返回取出的个数
+    template <typename F>
+    uint32_t consume(F &&f)
+    {
+        uint32_t count = 0;
+        uint32_t head = mHead.load(std::memory_order_relaxed);
+        while (true)
+        {
+            uint32_t tail = mTail.load(std::memory_order_seq_cst);
+            if (head == tail)
+            {
+                break;
+            }
+
+            for (; head != tail; ++head, ++count)
+            {
+                f(mItems[head & mMask]);
+            }
+            mHead.store(head, std::memory_order_seq_cst);
+        }
+
+        return count;
+    }
+
+    inline uint32_t capacity() { return mCapacity; }
+
+protected:
+    T *mItems;
+    uint32_t mCapacity;
+    uint32_t mMask;
+
+    // 生产者与消费者各自写入的字段分处不同的 cache line
+    char mPad0[64];
+    std::atomic<uint32_t> mHead;
+    char mPad1[64];
+    std::atomic<uint32_t> mTail;
+    uint32_t mProducerTail; // producer only
+    uint32_t mProducerHead; // producer only, cached mHead
+    char mPad2[64];
+};
+
+} // namespace utils
+} // namespace mapper
+
+#endif // __MAPPER_UTILS_SPSCRING_H__
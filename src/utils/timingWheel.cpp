@@ -0,0 +1,144 @@
+#include "timingWheel.h"
+#include <assert.h>
+
+namespace mapper
+{
+namespace utils
+{
+
+TimingWheel::TimingWheel() : mCurrent(0), mSize(0)
+{
+    for (auto &head : mSlots)
+    {
+        head = nullptr;
+    }
+    for (auto &bitmap : mBitmap)
+    {
+        bitmap = 0;
+    }
+}
+
+void TimingWheel::add(uint64_t curTime, uint32_t timeout, Entity_t *p)
+{
+    inWheel(p) && (unlink(p), true);
+
+    // 时间轮为空时无需逐个 tick 追赶
+    (!mSize && curTime > mCurrent) && (mCurrent = curTime);
+
+    p->lastActive = curTime;
+    p->timeout = timeout;
+    schedule(curTime + timeout, p);
+}
+
+void TimingWheel::erase(Entity_t *p)
+{
+    inWheel(p) && (unlink(p), true);
+}
+
+uint64_t TimingWheel::nextExpire()
+{
+    uint64_t next = UINT64_MAX;
+    for (uint32_t level = 0; level < WHEEL_LEVELS && mSize; ++level)
+    {
+        if (!mBitmap[level])
+        {
+            continue;
+        }
+
+        // 自当前槽位的下一个槽位起循环查找, 第 n 层的槽位在其起始时间下放
+        uint32_t shift = level * SLOT_BITS;
+        uint32_t from = ((mCurrent >> shift) + 1) & SLOT_MASK;
+        uint64_t bitmap = mBitmap[level];
+        bitmap = from ? (bitmap >> from) | (bitmap << (WHEEL_SLOTS - from)) : bitmap;
+        uint32_t index = (from + __builtin_ctzll(bitmap)) & SLOT_MASK;
+
+        uint64_t round = (mCurrent >> (shift + SLOT_BITS)) << (shift + SLOT_BITS);
+        uint64_t tick = round + ((uint64_t)index << shift);
+        tick <= mCurrent && (tick += 1ULL << (shift + SLOT_BITS));
+        tick < next && (next = tick);
+    }
+
+    return next;
+}
+
+void TimingWheel::schedule(uint64_t deadline, Entity_t *p)
+{
+    // 相对于下一个待处理的 tick 放置, 已过期的对象在下一个 tick 处理
+    uint64_t base = mCurrent + 1;
+    deadline < base && (deadline = base);
+
+    uint64_t delta = deadline - base;
+    uint32_t level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1ULL << ((level + 1) * SLOT_BITS)))
+    {
+        ++level;
+    }
+    if (delta >= (1ULL << (WHEEL_LEVELS * SLOT_BITS)))
+    {
+        // 超出时间轮范围, 到期时重新检查
+        deadline = base + (1ULL << (WHEEL_LEVELS * SLOT_BITS)) - 1;
+    }
+
+    link(level * WHEEL_SLOTS + ((deadline >> (level * SLOT_BITS)) & SLOT_MASK), p);
+}
+
+void TimingWheel::cascade(uint64_t tick)
+{
+    // 第 n 层的当前槽位在第 n - 1 层转完一圈时下放, 其中的对象均在 tick 之后的一个第 n - 1 层周期内到期
+    for (uint32_t level = 1; level < WHEEL_LEVELS; ++level)
+    {
+        uint32_t index = (tick >> (level * SLOT_BITS)) & SLOT_MASK;
+        uint16_t slot = level * WHEEL_SLOTS + index;
+        if (mSlots[slot])
+        {
+            moveSlot(slot, SLOT_FIRING);
+            for (Entity_t *p; (p = mSlots[SLOT_FIRING]);)
+            {
+                unlink(p);
+                schedule(p->lastActive + p->timeout, p);
+            }
+        }
+        if (index)
+        {
+            break;
+        }
+    }
+}
+
+void TimingWheel::moveSlot(uint16_t src, uint16_t dst)
+{
+    assert(!mSlots[dst]);
+
+    for (auto p = mSlots[src]; p; p = p->next)
+    {
+        p->slot = dst;
+    }
+    mSlots[dst] = mSlots[src];
+    mSlots[src] = nullptr;
+    mBitmap[src / WHEEL_SLOTS] &= ~(1ULL << (src % WHEEL_SLOTS));
+}
+
+void TimingWheel::link(uint16_t slot, Entity_t *p)
+{
+    p->slot = slot;
+    p->prev = nullptr;
+    p->next = mSlots[slot];
+    p->next && (p->next->prev = p, true);
+    mSlots[slot] = p;
+    slot < SLOT_FIRING && (mBitmap[slot / WHEEL_SLOTS] |= 1ULL << (slot % WHEEL_SLOTS), true);
+    ++mSize;
+}
+
+void TimingWheel::unlink(Entity_t *p)
+{
+    auto slot = p->slot;
+    p->prev ? (p->prev->next = p->next) : (mSlots[slot] = p->next);
+    p->next && (p->next->prev = p->prev, true);
+    (slot < SLOT_FIRING && !mSlots[slot]) && (mBitmap[slot / WHEEL_SLOTS] &= ~(1ULL << (slot % WHEEL_SLOTS)), true);
+    p->prev = p->next = nullptr;
+    p->slot = SLOT_NONE;
+    --mSize;
+}
+
+} // namespace utils
+} // namespace mapper
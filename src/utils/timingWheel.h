@@ -0,0 +1,144 @@
+/**
+ * @file timingWheel.h
+ * @author Liu Yu (source@liuyu.com)
+ * @brief Hierarchical timing wheel with lazy refresh.
+ * @version 1.0
+ * @date 2020-03-06
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef __MAPPER_UTILS_TIMINGWHEEL_H__
+#define __MAPPER_UTILS_TIMINGWHEEL_H__
+
+#include <stdint.h>
+
+namespace mapper
+{
+namespace utils
+{
+
+/**
+ * 分层时间轮, 时间单位为 ms (单调时钟, 见 Clock):
+ *
+ * - 共 WHEEL_LEVELS 层, 每层 WHEEL_SLOTS 个槽位, 第 n 层每个槽位跨度为 WHEEL_SLOTS^n ms,
+ *   第 0 层转完一圈时将上层当前槽位中的对象按剩余时间下放
+ * - 对象记录最后活跃时间及超时时长, refresh() 只更新活跃时间, 不调整其在时间轮中的位置;
+ *   所在槽位到期时才检查真实的超时时间, 未超时的对象按新的超时时间重新放入时间轮
+ * - 超出时间轮范围的对象放入最高层的最远槽位, 到期时同样重新检查
+ */
+class TimingWheel
+{
+protected:
+    static const uint32_t SLOT_BITS = 6;
+    static const uint32_t WHEEL_SLOTS = 1 << SLOT_BITS;
+    static const uint32_t SLOT_MASK = WHEEL_SLOTS - 1;
+    static const uint32_t WHEEL_LEVELS = 5; // 可直接表示约 12 天
+    static const uint16_t SLOT_FIRING = WHEEL_LEVELS * WHEEL_SLOTS; // 正在处理的到期对象
+    static const uint16_t SLOT_NONE = 0xffff;                       // 不在时间轮中
+
+public:
+    struct Entity_t
+    {
+        Entity_t *prev;
+        Entity_t *next;
+        void *container;
+        uint64_t lastActive; // ms
+        uint32_t timeout;    // ms
+        uint16_t slot;
+
+        inline void init(void *_container)
+        {
+            prev = next = nullptr;
+            container = _container;
+            lastActive = 0;
+            timeout = 0;
+            slot = SLOT_NONE;
+        }
+    };
+
+    TimingWheel();
+    ~TimingWheel() {}
+
+    TimingWheel(const TimingWheel &) = delete;
+    TimingWheel &operator=(const TimingWheel &) = delete;
+
+    inline bool inWheel(Entity_t *p) { return p->slot != SLOT_NONE; }
+    inline uint32_t size() { return mSize; }
+
+    // 以 curTime 为活跃时间加入时间轮, 已在时间轮中时按新的超时时长重新放置
+    void add(uint64_t curTime, uint32_t timeout, Entity_t *p);
+    // 不在时间轮中时忽略
+    void erase(Entity_t *p);
+    inline void refresh(uint64_t curTime, Entity_t *p) { p->lastActive = curTime; }
+    // 下一个需要处理 (到期或下放) 的非空槽位的时间, 时间轮为空时返回 UINT64_MAX;
+    // 对象的真实超时时间不早于此时间
+    uint64_t nextExpire();
+
+    // 处理至 curTime 为止到期的槽位, 对已超时的对象调用 f(Entity_t *), 调用前对象已移出时间轮;
+    // f 中可以加入/移除任意对象
+    template <typename F>
+    void expire(uint64_t curTime, F &&f)
+    {
+        while (mCurrent < curTime)
+        {
+            if (!mSize)
+            {
+                mCurrent = curTime;
+                break;
+            }
+
+            uint64_t tick = mCurrent + 1;
+            uint32_t index = tick & SLOT_MASK;
+            (index == 0) && (cascade(tick), true);
+            mCurrent = tick;
+
+            if (mSlots[index])
+            {
+                // 整个槽位移入 SLOT_FIRING 后逐个取出, f 中移除其他到期对象时链表仍然完整
+                moveSlot(index, SLOT_FIRING);
+                for (Entity_t *p; (p = mSlots[SLOT_FIRING]);)
+                {
+                    unlink(p);
+                    uint64_t deadline = p->lastActive + p->timeout;
+                    deadline <= curTime ? f(p) : schedule(deadline, p);
+                }
+            }
+
+            // 跳过第 0 层本圈内余下的空槽位
+            uint64_t rest = index == SLOT_MASK ? 0 : mBitmap[0] & (~0ULL << (index + 1));
+            uint64_t next = rest ? (tick & ~(uint64_t)SLOT_MASK) + __builtin_ctzll(rest) : (tick | SLOT_MASK) + 1;
+            mCurrent = next - 1 < curTime ? next - 1 : curTime;
+        }
+    }
+
+    // f(Entity_t *), f 中不可修改时间轮
+    template <typename F>
+    void forEach(F &&f)
+    {
+        for (auto head : mSlots)
+        {
+            for (auto p = head; p; p = p->next)
+            {
+                f(p);
+            }
+        }
+    }
+
+protected:
+    void schedule(uint64_t deadline, Entity_t *p);
+    void cascade(uint64_t tick);
+    void moveSlot(uint16_t src, uint16_t dst);
+    void link(uint16_t slot, Entity_t *p);
+    void unlink(Entity_t *p);
+
+    Entity_t *mSlots[WHEEL_LEVELS * WHEEL_SLOTS + 1];
+    uint64_t mBitmap[WHEEL_LEVELS]; // 各层非空槽位
+    uint64_t mCurrent;              // 已处理至此 tick (ms)
+    uint32_t mSize;
+};
+
+} // namespace utils
+} // namespace mapper
+
+#endif // __MAPPER_UTILS_TIMINGWHEEL_H__